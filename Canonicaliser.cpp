@@ -0,0 +1,269 @@
+#include "Canonicaliser.h"
+
+template <uint8_t Box>
+void Canonicaliser<Box>::Canonical( const uint8_t* values, uint8_t* result )
+{
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+    {
+        Grid[0][cell] = values[cell];
+        Grid[1][cell] = values[cell%N*N + cell/N];
+    }
+    // Every row and column holding every value
+    Complete = true;
+    for( uint16_t i = 0 ; i < 2*N && Complete ; i++ )
+    {
+        uint32_t seen = 0;
+        for( uint8_t j = 0 ; j < N ; j++ )
+            seen |= 1ul << Grid[i/N][i%N*N + j];
+        Complete = seen == ((1ul << N) - 1) << 1;
+    }
+    memset(Labels, 0, sizeof(Labels));
+    NextLabel = 0;
+    RowsUsed = ColsUsed = BandsUsed = StacksUsed = 0;
+    BestValid = 0;
+    for( uint8_t t = 0 ; t < 2 ; t++ )
+    {
+        Source = Grid[t];
+        ChooseRow(0);
+    }
+    memcpy(result, Best, CellCount);
+}
+
+template <uint8_t Box>
+uint64_t Canonicaliser<Box>::Hash( const uint8_t* values )
+{
+    uint8_t canonical[CellCount];
+    Canonical(values, canonical);
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+    {
+        hash ^= canonical[cell];
+        hash *= 1099511628211ull;
+    }
+    return hash ? hash : 1;
+}
+
+template <uint8_t Box>
+uint64_t Canonicaliser<Box>::Hash( const Board& board )
+{
+    bool useFixed = board.CountGivens() == 0;
+    uint8_t values[CellCount];
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+    {
+        const typename Board::Square& square = board.GetCell(cell);
+        values[cell] = (useFixed || board.IsGiven(cell%N, cell/N)) && square.Fixed() ? square.FirstPossible() : 0;
+    }
+    return Hash(values);
+}
+
+// Values are labelled in the order they are first seen, which is the smallest labelling for the cells chosen
+template <uint8_t Box>
+uint8_t Canonicaliser<Box>::Label( uint8_t value )
+{
+    if( value == 0 )
+        return 0;
+    if( Labels[value] == 0 )
+    {
+        Labelled[NextLabel] = value;
+        Labels[value] = ++NextLabel;
+    }
+    return Labels[value];
+}
+
+template <uint8_t Box>
+void Canonicaliser<Box>::Unlabel( uint8_t mark )
+{
+    while( NextLabel > mark )
+        Labels[Labelled[--NextLabel]] = 0;
+}
+
+// Everything before cell matches Best, as anything worse has already been dropped
+template <uint8_t Box>
+bool Canonicaliser<Box>::Emit( uint16_t cell, uint8_t value )
+{
+    if( cell < BestValid )
+    {
+        if( value > Best[cell] )
+            return false;
+        if( value == Best[cell] )
+            return true;
+    }
+    Best[cell] = value;
+    BestValid = cell+1;
+    return true;
+}
+
+// The first row also chooses the columns, later ones are compared a whole row at a time
+template <uint8_t Box>
+void Canonicaliser<Box>::ChooseRow( uint8_t row )
+{
+    if( row == N )
+        return;
+    // Any row of a band not used yet, or another of the same band
+    uint8_t from = row%Box == 0 ? 0 : Rows[row-1]/Box*Box;
+    uint8_t to = row%Box == 0 ? N : from+Box;
+    for( uint8_t source = from ; source < to ; source++ )
+    {
+        uint8_t band = source/Box;
+        if( row%Box == 0 ? (BandsUsed & (1ul << band)) != 0 : (RowsUsed & (1ul << source)) != 0 )
+            continue;
+        Rows[row] = source;
+        RowsUsed |= 1ul << source;
+        BandsUsed |= 1ul << band;
+        if( row == 0 )
+        {
+            if( Complete )
+                ChooseSecondRow();
+            else
+                ChooseCol(0);
+        }
+        else
+        {
+            uint8_t mark = NextLabel;
+            const uint8_t* values = Source + source*N;
+            uint8_t col = 0;
+            for( ; col < N && Emit(row*N + col, Label(values[Cols[col]])) ; col++ )
+                ;
+            if( col == N )
+                ChooseRow(row+1);
+            Unlabel(mark);
+        }
+        RowsUsed &= ~(1ul << source);
+        if( row%Box == 0 )
+            BandsUsed &= ~(1ul << band);
+    }
+}
+
+template <uint8_t Box>
+void Canonicaliser<Box>::ChooseCol( uint8_t col )
+{
+    const uint8_t* values = Source + Rows[0]*N;
+    for( uint8_t source = 0 ; source < N ; source++ )
+    {
+        uint8_t stack = source/Box;
+        if( col%Box == 0 ? (StacksUsed & (1ul << stack)) != 0 : (stack != Cols[col-1]/Box || (ColsUsed & (1ul << source)) != 0) )
+            continue;
+        uint8_t mark = NextLabel;
+        if( Emit(col, Label(values[source])) )
+        {
+            Cols[col] = source;
+            ColsUsed |= 1ul << source;
+            StacksUsed |= 1ul << stack;
+            if( col == N-1 )
+                ChooseRow(1);
+            else
+                ChooseCol(col+1);
+            ColsUsed &= ~(1ul << source);
+            if( col%Box == 0 )
+                StacksUsed &= ~(1ul << stack);
+        }
+        Unlabel(mark);
+    }
+}
+
+// The first row of a complete grid is labelled in column order, so the second row's values are the
+// positions of the columns above them. Each column's value is placed as early as it can go.
+template <uint8_t Box>
+void Canonicaliser<Box>::ChooseSecondRow()
+{
+    const uint8_t* first = Source + Rows[0]*N;
+    uint8_t columnOf[N+1];
+    for( uint8_t col = 0 ; col < N ; col++ )
+    {
+        columnOf[first[col]] = col;
+        Emit(col, col+1);
+    }
+    for( uint8_t source = Rows[0]/Box*Box ; source < Rows[0]/Box*Box + Box ; source++ )
+    {
+        if( RowsUsed & (1ul << source) )
+            continue;
+        Rows[1] = source;
+        RowsUsed |= 1ul << source;
+        const uint8_t* second = Source + source*N;
+        for( uint8_t col = 0 ; col < N ; col++ )
+            Above[col] = columnOf[second[col]];
+        memset(Cols, NotPlaced, sizeof(Cols));
+        memset(Position, NotPlaced, sizeof(Position));
+        memset(StackAt, NotPlaced, sizeof(StackAt));
+        memset(StackPosition, NotPlaced, sizeof(StackPosition));
+        ChooseGridCol(0);
+        RowsUsed &= ~(1ul << source);
+    }
+}
+
+template <uint8_t Box>
+void Canonicaliser<Box>::ChooseGridCol( uint8_t col )
+{
+    if( col == N )
+    {
+        const uint8_t* first = Source + Rows[0]*N;
+        for( uint8_t i = 0 ; i < N ; i++ )
+            Label(first[Cols[i]]);
+        ChooseRow(2);
+        Unlabel(0);
+        return;
+    }
+    // Already placed as the value of an earlier column, or any free column of its stack
+    uint8_t stack = col/Box;
+    bool placed = Cols[col] == NotPlaced;
+    uint8_t from = !placed ? Cols[col] : StackAt[stack] != NotPlaced ? StackAt[stack]*Box : 0;
+    uint8_t to = !placed ? from+1 : StackAt[stack] != NotPlaced ? from+Box : N;
+    for( uint8_t source = from ; source < to ; source++ )
+    {
+        if( placed && (Position[source] != NotPlaced || (StackAt[stack] == NotPlaced && StackPosition[source/Box] != NotPlaced)) )
+            continue;
+        uint8_t placedStack = placed ? Place(source, col) : NotPlaced;
+
+        uint8_t above = Above[source];
+        bool placedAbove = Position[above] == NotPlaced;
+        uint8_t placedAboveStack = NotPlaced;
+        if( placedAbove )
+        {
+            // The earliest free column of its stack, or the first of the next stack if it has none yet
+            uint8_t at = StackPosition[above/Box];
+            if( at == NotPlaced )
+                for( at = 0 ; StackAt[at] != NotPlaced ; at++ )
+                    ;
+            at *= Box;
+            while( Cols[at] != NotPlaced )
+                at++;
+            placedAboveStack = Place(above, at);
+        }
+
+        if( Emit(N + col, Position[above]+1) )
+            ChooseGridCol(col+1);
+
+        if( placedAbove )
+            Unplace(above, placedAboveStack);
+        if( placed )
+            Unplace(source, placedStack);
+    }
+}
+
+template <uint8_t Box>
+uint8_t Canonicaliser<Box>::Place( uint8_t source, uint8_t col )
+{
+    Cols[col] = source;
+    Position[source] = col;
+    if( StackAt[col/Box] != NotPlaced )
+        return NotPlaced;
+    StackAt[col/Box] = source/Box;
+    StackPosition[source/Box] = col/Box;
+    return col/Box;
+}
+
+template <uint8_t Box>
+void Canonicaliser<Box>::Unplace( uint8_t source, uint8_t stack )
+{
+    Cols[Position[source]] = NotPlaced;
+    Position[source] = NotPlaced;
+    if( stack == NotPlaced )
+        return;
+    StackPosition[StackAt[stack]] = NotPlaced;
+    StackAt[stack] = NotPlaced;
+}
+
+template class Canonicaliser<2>;
+template class Canonicaliser<3>;
+template class Canonicaliser<4>;
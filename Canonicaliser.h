@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "SudokuBoard.h"
+
+// Finds the smallest form of a puzzle, reading cells y*N+x with empty squares as 0, over every way of
+// transposing it, reordering the bands and the rows within them, reordering the stacks and the columns
+// within them, and relabelling the values. Puzzles that are the same apart from those have the same form.
+// Rows and columns are chosen as the cells are compared, with any choice that cannot match the smallest
+// found so far dropped straight away. Puzzles with many symmetries of their own take longest.
+// For complete grids the first row is always 1 to N, so the columns are chosen while comparing the second.
+template <uint8_t Box>
+class Canonicaliser : public BoardGeometry<Box>
+{
+public:
+    using Geometry = BoardGeometry<Box>;
+    using Geometry::N;
+    using Geometry::CellCount;
+    using Board = SudokuBoard<Box>;
+
+    // values are 0 for an empty square, result gets CellCount values
+    void            Canonical( const uint8_t* values, uint8_t* result );
+    uint64_t        Hash( const uint8_t* values );      // Never 0
+    // Of the board's givens, or its fixed squares if no givens are recorded
+    uint64_t        Hash( const Board& board );
+
+protected:
+    uint8_t         Grid[2][CellCount];     // The puzzle, and transposed
+    const uint8_t*  Source = nullptr;       // The one being tried
+    uint8_t         Rows[N];                // Source row for each row of the result
+    uint8_t         Cols[N];
+    uint32_t        RowsUsed = 0;
+    uint32_t        ColsUsed = 0;
+    uint32_t        BandsUsed = 0;
+    uint32_t        StacksUsed = 0;
+    uint8_t         Labels[N+1];            // For each source value, 0 until it is seen
+    uint8_t         Labelled[N];            // The source value given each label, so they can be undone
+    uint8_t         NextLabel = 0;
+    uint8_t         Best[CellCount];
+    uint16_t        BestValid = 0;          // Cells of Best found so far
+
+    // For complete grids
+    static constexpr uint8_t NotPlaced = 0xFF;
+    bool            Complete = false;
+    uint8_t         Above[N];               // The column of the first row holding each column's value in the second
+    uint8_t         Position[N];            // Of each source column, NotPlaced if not chosen yet
+    uint8_t         StackAt[Box];           // Source stack for each stack of the result
+    uint8_t         StackPosition[Box];
+
+    uint8_t         Label( uint8_t value );
+    void            Unlabel( uint8_t mark );
+    bool            Emit( uint16_t cell, uint8_t value );   // returns false if it makes this worse than Best
+    void            ChooseRow( uint8_t row );
+    void            ChooseCol( uint8_t col );
+    void            ChooseSecondRow();
+    void            ChooseGridCol( uint8_t col );
+    uint8_t         Place( uint8_t source, uint8_t col );   // returns the stack of the result assigned, or NotPlaced
+    void            Unplace( uint8_t source, uint8_t stack );
+};
@@ -0,0 +1,29 @@
+#include "CanvasPool.h"
+
+CanvasPool Canvases;
+
+M5EPD_Canvas* CanvasPool::Borrow( const Size<uint16_t>& size )
+{
+    for( auto& slot : Slots )
+        if( !slot.InUse && slot.CanvasSize == size )
+        {
+            slot.InUse = true;
+            return slot.Canvas.get();
+        }
+
+    log_d("Allocating canvas (%d,%d)", size.cx, size.cy);
+    Slot slot;
+    slot.Canvas.reset(new M5EPD_Canvas(&M5.EPD));
+    slot.Canvas->createCanvas(size.cx, size.cy);
+    slot.CanvasSize = size;
+    slot.InUse = true;
+    Slots.push_back(std::move(slot));
+    return Slots.back().Canvas.get();
+}
+
+void CanvasPool::Return( M5EPD_Canvas* canvas )
+{
+    for( auto& slot : Slots )
+        if( slot.Canvas.get() == canvas )
+            slot.InUse = false;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <M5EPD.h>
+
+#include "Utility.h"
+
+// Canvases are allocated once (M5EPD_Canvas puts the frame buffer in PSRAM) and then lent out
+// by size, rather than being created and deleted every time a layout or dialog is shown
+class CanvasPool
+{
+protected:
+    struct Slot
+    {
+        std::unique_ptr<M5EPD_Canvas>   Canvas;
+        Size<uint16_t>                  CanvasSize;
+        bool                            InUse = false;
+    };
+    std::vector<Slot>   Slots;
+
+public:
+    M5EPD_Canvas*   Borrow( const Size<uint16_t>& size );
+    void            Return( M5EPD_Canvas* canvas );
+};
+
+extern CanvasPool Canvases;
@@ -0,0 +1,569 @@
+#include <bitset>
+#include <numeric>
+#include <random>
+#include <algorithm>
+
+#include "DifficultyRater.h"
+#include "Perf.h"
+
+extern std::mt19937 g_;
+
+uint32_t Rating::Score() const
+{
+    static const uint8_t weights[eTechniqueCount] = { 1, 2, 10, 20, 30, 50, 80 };
+    uint32_t score = 0;
+    for( uint8_t i = 0 ; i < eTechniqueCount ; i++ )
+        score += Steps[i] * weights[i];
+    if( Hardest == eGuessing )
+        score += 500;
+    return score;
+}
+
+const char* Rating::Name( eTechnique technique )
+{
+    switch( technique )
+    {
+        case eNakedSingle:      return "Naked single";
+        case eHiddenSingle:     return "Hidden single";
+        case eLockedCandidates: return "Locked candidates";
+        case eNakedSubset:      return "Naked subset";
+        case eHiddenSubset:     return "Hidden subset";
+        case eFish:             return "Fish";
+        case eColouring:        return "Colouring";
+        case eGuessing:         return "Guessing";
+        default:                return "?";
+    }
+}
+
+const char* Rating::Describe( TextBuffer& text ) const
+{
+    text << Name(Hardest) << ", score " << Score() << ", cost " << Cost << (Capped ? " (capped)" : "") << ":";
+    for( uint8_t i = 0 ; i < eTechniqueCount ; i++ )
+        if( Steps[i] )
+            text << " " << Name((eTechnique)i) << " " << Steps[i];
+    return text.c_str();
+}
+
+const DifficultyBand& DifficultyBand::Get( eLevel level )
+{
+    static const DifficultyBand bands[eLevelCount] = {
+        { Rating::eNakedSingle,      Rating::eHiddenSingle,  34, 3*1000 },
+        { Rating::eLockedCandidates, Rating::eNakedSubset,   30, 6*1000 },
+        { Rating::eHiddenSubset,     Rating::eColouring,     81, 15*1000 },
+        { Rating::eGuessing,         Rating::eGuessing,      81, 20*1000 },
+    };
+    return bands[level < eLevelCount ? level : eMedium];
+}
+
+const char* DifficultyBand::Name( eLevel level )
+{
+    switch( level )
+    {
+        case eEasy:     return "Easy";
+        case eMedium:   return "Medium";
+        case eHard:     return "Hard";
+        case eExpert:   return "Expert";
+        default:        return "?";
+    }
+}
+
+template <uint8_t Box>
+Rating DifficultyRater<Box>::Rate( const Board& board, uint32_t costCap )
+{
+    PERF_COUNT(eRatings);
+    Result = Rating();
+    CostCap = costCap;
+    Broken = false;
+    Unfilled = CellCount;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        Candidates[cell] = Square::AllMask;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+    {
+        const Square& square = board.GetCell(cell);
+        if( square.Fixed() )
+        {
+            if( !(Candidates[cell] & square.Mask()) )
+                Broken = true;
+            Place(cell, square.FirstPossible());
+        }
+    }
+
+    while( Unfilled > 0 && !Broken )
+    {
+        uint16_t steps = 0;
+        uint8_t technique = 0;
+        for( ; technique < Rating::eTechniqueCount && !OverCap() ; technique++ )
+            if( (steps = Apply((Rating::eTechnique)technique)) > 0 )
+                break;
+        if( steps == 0 )
+        {
+            Result.Capped = OverCap();
+            Result.Hardest = Rating::eGuessing;
+            break;
+        }
+        Result.Steps[technique] += steps;
+        if( technique > Result.Hardest )
+            Result.Hardest = (Rating::eTechnique)technique;
+    }
+    Result.Solved = Unfilled == 0 && !Broken;
+    if( Broken )
+        Result.Hardest = Rating::eGuessing;
+    return Result;
+}
+
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::Apply( Rating::eTechnique technique )
+{
+    switch( technique )
+    {
+        case Rating::eNakedSingle:      return NakedSingles();
+        case Rating::eHiddenSingle:     return HiddenSingle();
+        case Rating::eLockedCandidates: return LockedCandidates();
+        case Rating::eNakedSubset:      return NakedSubset();
+        case Rating::eHiddenSubset:     return HiddenSubset();
+        case Rating::eFish:             return Fish();
+        case Rating::eColouring:        return Colouring();
+        default:                        return 0;
+    }
+}
+
+template <uint8_t Box>
+void DifficultyRater<Box>::Place( uint16_t cell, uint8_t val )
+{
+    tdMask bit = Square::Bit(val);
+    Candidates[cell] = 0;
+    Unfilled--;
+    const tdCell* peers = Geometry::Peers + cell*PeerCount;
+    for( uint8_t i = 0 ; i < PeerCount ; i++ )
+        Eliminate(peers[i], bit);
+}
+
+template <uint8_t Box>
+bool DifficultyRater<Box>::Eliminate( uint16_t cell, tdMask mask )
+{
+    if( !(Candidates[cell] & mask) )
+        return false;
+    Candidates[cell] &= ~mask;
+    if( Candidates[cell] == 0 )
+        Broken = true;
+    return true;
+}
+
+template <uint8_t Box>
+template <class F>
+bool DifficultyRater<Box>::FindSubset( const uint32_t* masks, uint8_t count, uint8_t k, F& found, uint8_t start, uint32_t items, uint32_t unionMask, uint8_t size )
+{
+    if( size == k )
+        return found(items, unionMask);
+    for( uint8_t i = start ; i + (k - size) <= count ; i++ )
+    {
+        uint32_t combined = unionMask | masks[i];
+        if( __builtin_popcount(combined) <= k && FindSubset(masks, count, k, found, i+1, items | 1u << i, combined, size+1) )
+            return true;
+    }
+    return false;
+}
+
+// Every square with one value left
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::NakedSingles()
+{
+    Result.Cost += N;
+    uint16_t steps = 0;
+    for( uint16_t cell = 0 ; cell < CellCount && !Broken ; cell++ )
+        if( Candidates[cell] && Square::CountBits(Candidates[cell]) == 1 )
+        {
+            Place(cell, Square::CountBits(Candidates[cell] - 1) + 1);
+            steps++;
+        }
+    return steps;
+}
+
+// A value with one place left in a unit
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::HiddenSingle()
+{
+    for( uint8_t unit = 0 ; unit < UnitCount ; unit++ )
+    {
+        Result.Cost++;
+        const tdCell* cells = Geometry::Units + unit*N;
+        tdMask once = 0, twice = 0;
+        for( uint8_t i = 0 ; i < N ; i++ )
+        {
+            twice |= once & Candidates[cells[i]];
+            once |= Candidates[cells[i]];
+        }
+        tdMask single = once & ~twice;
+        if( !single )
+            continue;
+        tdMask bit = single & (tdMask)(~single + 1);
+        for( uint8_t i = 0 ; i < N ; i++ )
+            if( Candidates[cells[i]] & bit )
+            {
+                Place(cells[i], Square::CountBits(bit - 1) + 1);
+                return 1;
+            }
+    }
+    return 0;
+}
+
+// Where a value in a block is confined to one row or column it can go nowhere else in that line,
+// and where a value in a line is confined to one block it can go nowhere else in that block
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::LockedCandidates()
+{
+    for( uint8_t block = 0 ; block < N ; block++ )
+    {
+        const tdCell* blockCells = Geometry::Units + (2*N + block)*N;
+        // The block's rows, then its columns
+        for( uint8_t k = 0 ; k < 2*Box ; k++ )
+        {
+            Result.Cost++;
+            uint8_t side = k < Box ? 0 : 1;
+            uint8_t line = Geometry::CellUnits[(k < Box ? blockCells[k*Box] : blockCells[k-Box])*3 + side];
+            const tdCell* lineCells = Geometry::Units + line*N;
+            tdMask inside = 0, blockRest = 0, lineRest = 0;
+            for( uint8_t i = 0 ; i < N ; i++ )
+            {
+                if( Geometry::CellUnits[blockCells[i]*3 + side] == line )
+                    inside |= Candidates[blockCells[i]];
+                else
+                    blockRest |= Candidates[blockCells[i]];
+                if( Geometry::CellUnits[lineCells[i]*3 + 2] != 2*N + block )
+                    lineRest |= Candidates[lineCells[i]];
+            }
+            tdMask pointing = inside & ~blockRest & lineRest;
+            tdMask claiming = inside & ~lineRest & blockRest;
+            bool bChangeMade = false;
+            for( uint8_t i = 0 ; i < N ; i++ )
+            {
+                if( pointing && Geometry::CellUnits[lineCells[i]*3 + 2] != 2*N + block )
+                    bChangeMade |= Eliminate(lineCells[i], pointing);
+                if( claiming && Geometry::CellUnits[blockCells[i]*3 + side] != line )
+                    bChangeMade |= Eliminate(blockCells[i], claiming);
+            }
+            if( bChangeMade )
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// k squares of a unit between them holding only k values, which can then go nowhere else in it
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::NakedSubset()
+{
+    for( uint8_t k = 2 ; k <= 4 ; k++ )
+        for( uint8_t unit = 0 ; unit < UnitCount && !OverCap() ; unit++ )
+        {
+            Result.Cost += k;
+            const tdCell* cells = Geometry::Units + unit*N;
+            uint32_t masks[N];
+            uint8_t index[N];
+            uint8_t count = 0;
+            for( uint8_t i = 0 ; i < N ; i++ )
+                if( Candidates[cells[i]] )
+                {
+                    index[count] = i;
+                    masks[count++] = Candidates[cells[i]];
+                }
+            if( count <= k )
+                continue;
+            auto found = [&]( uint32_t items, uint32_t values ) -> bool
+            {
+                bool bChangeMade = false;
+                for( uint8_t j = 0 ; j < count ; j++ )
+                    if( !(items & (1u << j)) )
+                        bChangeMade |= Eliminate(cells[index[j]], (tdMask)values);
+                return bChangeMade;
+            };
+            if( FindSubset(masks, count, k, found) )
+                return 1;
+        }
+    return 0;
+}
+
+// k values of a unit between them with only k squares left, which can then hold nothing else
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::HiddenSubset()
+{
+    for( uint8_t k = 2 ; k <= 4 ; k++ )
+        for( uint8_t unit = 0 ; unit < UnitCount && !OverCap() ; unit++ )
+        {
+            Result.Cost += k;
+            const tdCell* cells = Geometry::Units + unit*N;
+            uint32_t masks[N];
+            uint8_t values[N];
+            uint8_t count = 0;
+            for( uint8_t val = 1 ; val <= N ; val++ )
+            {
+                uint32_t places = 0;
+                for( uint8_t i = 0 ; i < N ; i++ )
+                    if( Candidates[cells[i]] & Square::Bit(val) )
+                        places |= 1u << i;
+                if( places )
+                {
+                    values[count] = val;
+                    masks[count++] = places;
+                }
+            }
+            if( count <= k )
+                continue;
+            auto found = [&]( uint32_t items, uint32_t places ) -> bool
+            {
+                tdMask keep = 0;
+                for( uint8_t j = 0 ; j < count ; j++ )
+                    if( items & (1u << j) )
+                        keep |= Square::Bit(values[j]);
+                bool bChangeMade = false;
+                for( uint8_t i = 0 ; i < N ; i++ )
+                    if( places & (1u << i) )
+                        bChangeMade |= Eliminate(cells[i], (tdMask)~keep);
+                return bChangeMade;
+            };
+            if( FindSubset(masks, count, k, found) )
+                return 1;
+        }
+    return 0;
+}
+
+// A value confined to the same k columns in k rows can go nowhere else in those columns, and the same the other way round
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::Fish()
+{
+    for( uint8_t k = 2 ; k <= 4 ; k++ )
+        for( uint8_t val = 1 ; val <= N && !OverCap() ; val++ )
+        {
+            tdMask bit = Square::Bit(val);
+            // Rows as the base with columns as the cover, then columns with rows
+            for( uint8_t side = 0 ; side < 2 ; side++ )
+            {
+                Result.Cost += k;
+                uint32_t masks[N];
+                uint8_t lines[N];
+                uint8_t count = 0;
+                for( uint8_t line = 0 ; line < N ; line++ )
+                {
+                    const tdCell* cells = Geometry::Units + (side*N + line)*N;
+                    uint32_t places = 0;
+                    for( uint8_t i = 0 ; i < N ; i++ )
+                        if( Candidates[cells[i]] & bit )
+                            places |= 1u << i;
+                    if( places )
+                    {
+                        lines[count] = line;
+                        masks[count++] = places;
+                    }
+                }
+                if( count <= k )
+                    continue;
+                auto found = [&]( uint32_t items, uint32_t cover ) -> bool
+                {
+                    bool bChangeMade = false;
+                    for( uint8_t j = 0 ; j < count ; j++ )
+                    {
+                        if( items & (1u << j) )
+                            continue;
+                        const tdCell* cells = Geometry::Units + (side*N + lines[j])*N;
+                        for( uint8_t i = 0 ; i < N ; i++ )
+                            if( cover & (1u << i) )
+                                bChangeMade |= Eliminate(cells[i], bit);
+                    }
+                    return bChangeMade;
+                };
+                if( FindSubset(masks, count, k, found) )
+                    return 1;
+            }
+        }
+    return 0;
+}
+
+// For one value, squares linked by being the only two places for it in a unit alternate between
+// having it and not. Either colour seeing itself in a unit is false, and any square seeing both
+// colours of a chain cannot have the value.
+template <uint8_t Box>
+uint16_t DifficultyRater<Box>::Colouring()
+{
+    uint16_t colour[CellCount];         // Chain*2 + which of the pair, 0 if not in a chain
+    tdCell queue[CellCount];
+    uint8_t placesInUnit[UnitCount];
+    for( uint8_t val = 1 ; val <= N && !OverCap() ; val++ )
+    {
+        Result.Cost += UnitCount;
+        tdMask bit = Square::Bit(val);
+        for( uint8_t unit = 0 ; unit < UnitCount ; unit++ )
+        {
+            placesInUnit[unit] = 0;
+            for( uint8_t i = 0 ; i < N ; i++ )
+                if( Candidates[Geometry::Units[unit*N + i]] & bit )
+                    placesInUnit[unit]++;
+        }
+
+        memset(colour, 0, sizeof(colour));
+        uint16_t chain = 1;
+        for( uint16_t start = 0 ; start < CellCount ; start++ )
+        {
+            if( colour[start] || !(Candidates[start] & bit) )
+                continue;
+            uint16_t head = 0, tail = 0;
+            queue[tail++] = start;
+            colour[start] = chain*2;
+            while( head < tail )
+            {
+                tdCell cell = queue[head++];
+                for( uint8_t u = 0 ; u < 3 ; u++ )
+                {
+                    uint8_t unit = Geometry::CellUnits[cell*3 + u];
+                    if( placesInUnit[unit] != 2 )
+                        continue;
+                    for( uint8_t i = 0 ; i < N ; i++ )
+                    {
+                        tdCell other = Geometry::Units[unit*N + i];
+                        if( other != cell && (Candidates[other] & bit) && !colour[other] )
+                        {
+                            colour[other] = colour[cell] ^ 1;
+                            queue[tail++] = other;
+                        }
+                    }
+                }
+            }
+            // Squares on their own are no help
+            if( tail == 1 )
+                colour[start] = 0;
+            else
+                chain++;
+        }
+        if( chain == 1 )
+            continue;
+
+        // A colour twice in a unit
+        for( uint8_t unit = 0 ; unit < UnitCount ; unit++ )
+        {
+            const tdCell* cells = Geometry::Units + unit*N;
+            for( uint8_t i = 0 ; i < N ; i++ )
+                for( uint8_t j = i+1 ; colour[cells[i]] && j < N ; j++ )
+                    if( colour[cells[j]] == colour[cells[i]] )
+                    {
+                        uint16_t wrong = colour[cells[i]];
+                        for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+                            if( colour[cell] == wrong )
+                                Eliminate(cell, bit);
+                        return 1;
+                    }
+        }
+
+        // A square seeing both colours of a chain
+        std::bitset<2*CellCount+2> seen;
+        bool bChangeMade = false;
+        for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        {
+            if( !(Candidates[cell] & bit) )
+                continue;
+            const tdCell* peers = Geometry::Peers + cell*PeerCount;
+            bool both = false;
+            for( uint8_t i = 0 ; i < PeerCount && !both ; i++ )
+                if( colour[peers[i]] )
+                {
+                    both = seen[colour[peers[i]] ^ 1];
+                    seen.set(colour[peers[i]]);
+                }
+            for( uint8_t i = 0 ; i < PeerCount ; i++ )
+                seen.reset(colour[peers[i]]);
+            if( both )
+                bChangeMade |= Eliminate(cell, bit);
+        }
+        if( bChangeMade )
+            return 1;
+    }
+    return 0;
+}
+
+template <uint8_t Box>
+Rating DifficultyRater<Box>::Generate( Board& board, const DifficultyBand& band, SolveStats* stats )
+{
+    SOLVE_STATS_SCOPE(stats);
+    auto ts = millis();
+    ScratchArena& arena = board.GetArena();
+    ScratchArena::Mark mark(arena);
+    Board* bestSpace = arena.New<Board>(board);
+    Board* currentSpace = arena.New<Board>(board);
+    if( !bestSpace || !currentSpace )
+        return Rating();
+    Board& best = *bestSpace;
+    Board& current = *currentSpace;
+    Rating bestRating;
+    bool found = false;
+    uint16_t attempts = 0;
+    std::array<tdCell,CellCount> order;
+    do
+    {
+        attempts++;
+        current.GenerateSolved(stats);
+        Rating rating = Rate(current);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), g_);
+        uint16_t remaining = CellCount;
+        uint16_t clues = CellCount;
+
+        while( remaining > 0 && !(band.Contains(rating) && clues <= band.MaxClues) )
+        {
+            // Of the next few cells, take out the one leaving the hardest puzzle that is not past the band.
+            // Cells that cannot go now never can, as taking out more only makes that worse.
+            uint8_t window = min<uint16_t>(Lookahead, remaining);
+            int8_t pick = -1;
+            Rating pickRating;
+            for( uint8_t i = 0 ; i < window ; )
+            {
+                // Tried in place, neither the uniqueness check nor the rating changes the squares
+                Square removed = current.GetCell(order[i]);
+                current.GetCell(order[i]) = Square();
+                Rating checkRating;
+                bool usable = current.SolveUniquely(stats) == 1 && (checkRating = Rate(current)).Hardest <= band.MaxHardest;
+                current.GetCell(order[i]) = removed;
+                if( usable )
+                {
+                    if( pick < 0 || Harder(checkRating, pickRating) )
+                    {
+                        pick = i;
+                        pickRating = checkRating;
+                    }
+                    i++;
+                    continue;
+                }
+                // The last cell takes its place, so is tried next if it is not already in the window
+                order[i] = order[--remaining];
+                window = min<uint16_t>(window, remaining);
+            }
+            if( pick < 0 )
+                continue;
+            current.GetCell(order[pick]) = Square();
+            order[pick] = order[--remaining];
+            clues--;
+            rating = pickRating;
+        }
+        TextBuffer text;
+        log_d("Attempt %d: %d clues, %s", attempts, clues, rating.Describe(text));
+
+        // Short of the band the hardest is closest, within it the one with fewest clues
+        bool inBand = band.Contains(rating);
+        if( !found || (inBand && !band.Contains(bestRating)) || (!inBand && !band.Contains(bestRating) && Harder(rating, bestRating))
+            || (inBand && band.Contains(bestRating) && clues < best.CountFixed()) )
+        {
+            best = current;
+            bestRating = rating;
+            found = true;
+        }
+        if( inBand && clues <= band.MaxClues )
+            break;
+    } while( millis() - ts < band.TimeMS );
+
+    TextBuffer text;
+    log_d("Generated %s in %d attempts, %dms", bestRating.Describe(text), attempts, millis() - ts);
+    board = best;
+    board.MarkFixedAsGiven();
+    return bestRating;
+}
+
+template class DifficultyRater<2>;
+template class DifficultyRater<3>;
+template class DifficultyRater<4>;
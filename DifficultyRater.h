@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "SudokuBoard.h"
+
+// How hard a puzzle is for a person, from the techniques needed to solve it without guessing
+struct Rating
+{
+    // In the order they are tried, easiest first
+    enum eTechnique : uint8_t {
+        eNakedSingle,
+        eHiddenSingle,
+        eLockedCandidates,      // Pointing and claiming
+        eNakedSubset,           // Pairs, triples and quads
+        eHiddenSubset,
+        eFish,                  // X-wing, swordfish and jellyfish
+        eColouring,             // Chains of squares where one value must go in one of two
+        eTechniqueCount,
+        eGuessing = eTechniqueCount,    // None of them helped, or the cost cap was reached
+    };
+
+    eTechnique  Hardest = eNakedSingle;
+    uint16_t    Steps[eTechniqueCount] = {};
+    uint32_t    Cost = 0;               // Roughly one per unit scanned
+    bool        Solved = false;
+    bool        Capped = false;         // Gave up at the cost cap
+
+    uint32_t    Score() const;          // Steps weighted by how hard their technique is
+    static const char* Name( eTechnique technique );
+    const char* Describe( TextBuffer& text ) const;     // returns the text
+};
+
+// The levels offered for new games, each a range of hardest technique for the 9x9 game
+struct DifficultyBand
+{
+    enum eLevel : uint8_t {
+        eEasy,
+        eMedium,
+        eHard,
+        eExpert,
+        eLevelCount
+    };
+
+    Rating::eTechnique  MinHardest;
+    Rating::eTechnique  MaxHardest;
+    uint16_t            MaxClues;       // Digging stops once in the band with no more than this many
+    uint32_t            TimeMS;         // To find one, after which the closest found is used
+
+    bool                Contains( const Rating& rating ) const { return rating.Hardest >= MinHardest && rating.Hardest <= MaxHardest; };
+    static const DifficultyBand& Get( eLevel level );
+    static const char*  Name( eLevel level );
+};
+
+// Solves with a ladder of techniques, always going back to the easiest after any progress,
+// working on candidate masks of its own rather than the board's marks
+template <uint8_t Box>
+class DifficultyRater : public BoardGeometry<Box>
+{
+public:
+    using Geometry = BoardGeometry<Box>;
+    using Geometry::N;
+    using Geometry::CellCount;
+    using Geometry::UnitCount;
+    using Geometry::PeerCount;
+    using typename Geometry::tdCell;
+    using Board = SudokuBoard<Box>;
+    using Square = typename Board::Square;
+    using tdMask = typename Board::tdMask;
+
+    static constexpr uint32_t DefaultCostCap = 20000;
+    static constexpr uint8_t  Lookahead = 3;     // Cells tried for each one removed when generating
+
+    // Rates the puzzle given by the board's fixed squares
+    Rating          Rate( const Board& board, uint32_t costCap = DefaultCostCap );
+    // Digs clues out of random grids until the rating is in the band, returns the rating of the puzzle
+    // left in the board, which is the closest found if the time ran out first. The board is left alone
+    // if the arena runs out, check ScratchArena::HasOverflowed.
+    Rating          Generate( Board& board, const DifficultyBand& band, SolveStats* stats = nullptr );
+
+protected:
+    tdMask          Candidates[CellCount];      // 0 once filled in
+    uint16_t        Unfilled = 0;
+    bool            Broken = false;             // A square has no value left
+    Rating          Result;
+    uint32_t        CostCap = DefaultCostCap;
+
+    bool            OverCap() const { return Result.Cost > CostCap; };
+    static bool     Harder( const Rating& a, const Rating& b ) { return a.Hardest != b.Hardest ? a.Hardest > b.Hardest : a.Score() > b.Score(); };
+    void            Place( uint16_t cell, uint8_t val );
+    bool            Eliminate( uint16_t cell, tdMask mask );    // returns true if any were removed
+
+    // Each returns the number of steps taken, 0 if the technique does not apply
+    uint16_t        NakedSingles();
+    uint16_t        HiddenSingle();
+    uint16_t        LockedCandidates();
+    uint16_t        NakedSubset();
+    uint16_t        HiddenSubset();
+    uint16_t        Fish();
+    uint16_t        Colouring();
+    uint16_t        Apply( Rating::eTechnique technique );
+
+    // Calls found(items, union) for sets of k of the masks whose union has at most k bits, until it returns true
+    template <class F>
+    static bool     FindSubset( const uint32_t* masks, uint8_t count, uint8_t k, F& found, uint8_t start = 0, uint32_t items = 0, uint32_t unionMask = 0, uint8_t size = 0 );
+};
@@ -3,109 +3,236 @@
 #include "Utility.h"
 
 #include "LayoutItem.h"
+#include "CanvasPool.h"
+#include "InputManager.h"
+#include "MoveJournal.h"
+#include "PowerManager.h"
+#include "SaveSlots.h"
+#include "Perf.h"
+#include "Validator.h"
+#include "DifficultyRater.h"
+#include "SeedBank.h"
+#include "PuzzleCollection.h"
+#include "ScratchArena.h"
 
 #include <Preferences.h>
+#include <esp_heap_caps.h>
 
 #include "SudokuState.h"
 
 extern SudokuState CurrentState;
-extern String LastValidation;
+extern Point<uint8_t> CurrentSquare;
+extern TextBuffer LastValidation;
 
 Preferences preferences;
 const char* Preferences_App = "M5Sudoku";
 
-std::vector<uint8_t> vector_rand81(81);
 std::random_device rd_;
 std::mt19937 g_(rd_());
 
-uint8_t  TargetFixedCells = 24;
+DifficultyBand::eLevel TargetLevel = DifficultyBand::eMedium;
+uint8_t  TargetFixedCells = 0;          // Set to generate by clue count rather than difficulty
 uint32_t TargetSolveTimeMS = 60 * 1000;
+bool     AutoCandidates = false;
+bool     InstantGames = false;      // From the seed bank rather than generated
+uint32_t CollectionNumber = 0;      // Last puzzle picked from the collection on the SD card
 
 DisplayManager BaseDisplayManager;
 
+QueueHandle_t           DisplayManager::UpdateQueue = nullptr;
+SemaphoreHandle_t       DisplayManager::Mutex = nullptr;
+std::atomic<uint32_t>   DisplayManager::PendingUpdates{0};
+DisplayManager*         DisplayManager::Layers[MaxLayers];
+uint8_t                 DisplayManager::LayerCount = 0;
+uint8_t*                DisplayManager::ComposeBuffer = nullptr;
+
+DisplayLock::DisplayLock()
+{
+    if( DisplayManager::Mutex )
+        xSemaphoreTakeRecursive(DisplayManager::Mutex, portMAX_DELAY);
+}
+
+DisplayLock::~DisplayLock()
+{
+    if( DisplayManager::Mutex )
+        xSemaphoreGiveRecursive(DisplayManager::Mutex);
+}
+
 DisplayManager::DisplayManager()
-: Canvas(&M5.EPD)
 {
 
 }
 
 M5EPD_Canvas& DisplayManager::GetCanvas()
 {
-    return Canvas;
+    return *Canvas;
 }
 
 void DisplayManager::Init( bool appInit )
 {
     if( appInit )
     {
-        M5.begin();
+        if( Power.IsResuming() )
+        {
+            Power.BeginAfterSleep();
+            CurrentLayout = (eLayout)Power.GetLayout();
+            Rotation = Power.GetRotation();
+        }
+        else
+        {
+            M5.begin();
 
-        preferences.begin(Preferences_App);
-        CurrentLayout = (eLayout)preferences.getChar("Layout",(int8_t)CurrentLayout);
-        Rotation = preferences.getShort("Rotation",(int16_t)Rotation);
-        preferences.end();
+            preferences.begin(Preferences_App);
+            CurrentLayout = (eLayout)preferences.getChar("Layout",(int8_t)CurrentLayout);
+            Rotation = preferences.getShort("Rotation",(int16_t)Rotation);
+            preferences.end();
+        }
         log_d("Battery voltage: %d", M5.getBatteryVoltage());
 
-        std::iota(vector_rand81.begin(), vector_rand81.end(), 0);
+        StartDisplayTask();
     }
 
     SetLayout(CurrentLayout);
+    ShowLayer();
 }
 
 void DisplayManager::SetLayout( eLayout layout )
 {
-    Canvas.deleteCanvas();
+    WaitForDisplayIdle();
+    DisplayLock lock;
 
-    LayoutItems.clear();
+    if( layout >= eLayoutCount )
+        layout = eBoard_Landscape;
+    if( !Layouts[layout] )
+    {
+        Layouts[layout].reset(new CachedLayout);
+        BuildLayout(layout, *Layouts[layout]);
+    }
+    CachedLayout& cached = *Layouts[layout];
 
-    bool clearCanvas = true;
     bool flip = Rotation >= 180;
+    uint16_t rotation = (cached.Rotation + (flip?180:0)) % 360;
+    bool changed = LayoutItems == nullptr || layout != CurrentLayout || rotation != Rotation;
+
+    LayoutItems = &cached.Items;
+    CanvasPos = cached.CanvasPos;
+    if( cached.Centred )
+    {
+        Size<uint16_t> screenSize = rotation % 180 == 0 ? Size<uint16_t>(960,540) : Size<uint16_t>(540,960);
+        CanvasPos = {(uint16_t)(((screenSize.cx - cached.CanvasSize.cx) / 2) & ~3), (uint16_t)((screenSize.cy - cached.CanvasSize.cy) / 2)};
+    }
+    if( Canvas && CanvasSize != cached.CanvasSize )
+        ReleaseCanvas();
+    CanvasSize = cached.CanvasSize;
+    if( !Canvas )
+    {
+        Canvas = Canvases.Borrow(CanvasSize);
+        changed = true;
+    }
+    CurrentLayout = layout;
+    Rotation = rotation;
+    log_d("New rotation %d",Rotation);
+
+    M5.TP.SetRotation(Rotation);
+    M5.EPD.SetRotation(Rotation);
+    if( changed )
+    {
+        Canvas->fillCanvas(0);
+        // After deep sleep the panel still shows this layout
+        if( cached.ClearScreen && !Power.IsResuming() )
+            M5.EPD.Clear(true);
+    }
+
+    log_d("Canvas size (%d,%d) at (%d,%d)", CanvasSize.cx, CanvasSize.cy, CanvasPos.x, CanvasPos.y);
+}
+
+void DisplayManager::ReleaseCanvas()
+{
+    WaitForDisplayIdle();
+    DisplayLock lock;
+
+    Canvases.Return(Canvas);
+    Canvas = nullptr;
+}
+
+static void StepCollection( int32_t step )
+{
+    uint32_t count = Collection.GetCount();
+    if( count == 0 )
+        return;
+    int64_t number = (int64_t)CollectionNumber + step;
+    CollectionNumber = number < 0 ? 0 : number >= count ? count - 1 : number;
+}
+
+// Clues and rating of the picked puzzle, only worked out again when it changes
+static const char* DescribeCollectionPuzzle()
+{
+    static uint32_t described = UINT32_MAX;
+    static TextBuffer description;
+    if( described != CollectionNumber )
+    {
+        described = CollectionNumber;
+        static DifficultyRater<3> rater;
+        SudokuState state;
+        description.clear();
+        if( Collection.Load(CollectionNumber, state) )
+            description << state.CountGivens() << " clues, " << Rating::Name(rater.Rate(state).Hardest);
+        else
+            description << "Not a puzzle with one solution";
+    }
+    return description.c_str();
+}
+
+void DisplayManager::BuildLayout( eLayout layout, CachedLayout& cached )
+{
+    LayoutTable& items = cached.Items;
+
     switch( layout )
     {
     case eLayout::eBoard_Portait:
     default:
-        Rotation = 90 + (flip?180:0);
-        CanvasPos = {0,0};
-        CanvasSize = {540,960};
+        cached.Rotation = 90;
+        cached.CanvasPos = {0,0};
+        cached.CanvasSize = {540,960};
         {
             uint16_t border = 18;
             uint16_t width = (540 - 2 * border) / 9;
             for( uint8_t x = 0 ; x < 9 ; x++ )
                 for( uint8_t y = 0 ; y < 9 ; y++ )
-                    LayoutItems.push_back( std::make_shared<LayoutItem_SudokuSquare>(
-                        Rect<uint16_t>(border + x*width,border + y*width,border + (x+1)*width,border + (y+1)*width), x, y) );
+                    items.add<LayoutItem_SudokuSquare>(
+                        Rect<uint16_t>(border + x*width,border + y*width,border + (x+1)*width,border + (y+1)*width), x, y);
         }
         break;
     case eLayout::eBoard_Landscape:
-        Rotation = 0 + (flip?180:0);
-        CanvasPos = {0,0};
-        CanvasSize = {960,540};
+        cached.Rotation = 0;
+        cached.CanvasPos = {0,0};
+        cached.CanvasSize = {960,540};
         {
             uint16_t border = 18;
             uint16_t width = 540;
             uint16_t widthOne = (width - 2 * border) / 9;
-            LayoutItems.push_back( std::make_shared<LayoutItem_SudokuMainBackground>(
-                Rect<uint16_t>(border,border,width - border,width - border)));
+            items.add<LayoutItem_SudokuMainBackground>(
+                Rect<uint16_t>(border,border,width - border,width - border));
             for( uint8_t x = 0 ; x < 9 ; x++ )
                 for( uint8_t y = 0 ; y < 9 ; y++ )
-                    LayoutItems.push_back( std::make_shared<LayoutItem_SudokuSquare>(
-                        Rect<uint16_t>(border + x*widthOne,border + y*widthOne,border + (x+1)*widthOne,border + (y+1)*widthOne), x, y) );
-            LayoutItems.push_back( std::make_shared<LayoutItem_SudokuGrid>(
-                Rect<uint16_t>(border,border,width - border,width - border)));
+                    items.add<LayoutItem_SudokuSquare>(
+                        Rect<uint16_t>(border + x*widthOne,border + y*widthOne,border + (x+1)*widthOne,border + (y+1)*widthOne), x, y);
+            items.add<LayoutItem_SudokuGrid>(
+                Rect<uint16_t>(border,border,width - border,width - border));
         }
         {
             uint16_t border = 18;
             uint16_t width = (540 - 2 * border) * 2 / 3;
             uint16_t offset = 540-border + (960-540-width)/2;
             uint16_t widthOne = (width - 2 * border) / 3;
-            LayoutItems.push_back( std::make_shared<LayoutItem_SudokuMainBackground>(
-                Rect<uint16_t>(offset + border,border,offset + width - border,width - border)));
+            items.add<LayoutItem_SudokuMainBackground>(
+                Rect<uint16_t>(offset + border,border,offset + width - border,width - border));
             for( uint8_t x = 0 ; x < 3 ; x++ )
                 for( uint8_t y = 0 ; y < 3 ; y++ )
-                    LayoutItems.push_back( std::make_shared<LayoutItem_SudokuSubSquare>(
-                        Rect<uint16_t>(Point<uint16_t>(offset + border + x*widthOne,border + y*widthOne),Size<uint16_t>(widthOne,widthOne)), 1 + y*3 + x) );
-            LayoutItems.push_back( std::make_shared<LayoutItem_SudokuGrid>(
-                Rect<uint16_t>(offset + border,border,offset + width - border,width - border), true));
+                    items.add<LayoutItem_SudokuSubSquare>(
+                        Rect<uint16_t>(Point<uint16_t>(offset + border + x*widthOne,border + y*widthOne),Size<uint16_t>(widthOne,widthOne)), 1 + y*3 + x);
+            items.add<LayoutItem_SudokuGrid>(
+                Rect<uint16_t>(offset + border,border,offset + width - border,width - border), true);
         }
         {
             uint16_t border = 18;
@@ -115,203 +242,416 @@ void DisplayManager::SetLayout( eLayout layout )
             uint16_t lineHeight = 56;
             uint8_t itemCount = 0;
             uint16_t itemBorder = 9;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX + border,offsetY + itemCount*(lineHeight + itemBorder)),Size<uint16_t>(1*width/2 - border,lineHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "Validate"; }
+                , []( TextBuffer& text ) { text << "Validate"; }
                 , []() -> bool { return true; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([]()
+                , []()
                 {
-                    SudokuState temp = CurrentState;
-                    temp.Propagate();
-                    uint8_t result = temp.SolveUniquely();
-                    LastValidation = result == 1 ? CurrentState.Solved() ? "Solved!" : "Valid" : result == 2 ? "Non-unique" : "Invalid";
-                    BaseDisplayManager.draw(true);
-                })));
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+                    // Mistakes are already shown, this only has to put a number on them
+                    uint8_t result;
+                    if( CurrentState.HasSolution() )
+                    {
+                        size_t mistakes = CurrentState.FindMistakes().count();
+                        LastValidation.clear();
+                        if( mistakes > 0 )
+                            LastValidation << mistakes << (mistakes == 1 ? " mistake" : " mistakes");
+                        else
+                            LastValidation << (CurrentState.Solved() ? "Solved!" : "Valid");
+                    }
+                    else if( Validator.GetResult(CurrentState, result) )
+                        LastValidation = BackgroundValidator::Describe(result, CurrentState.Solved());
+                    else
+                    {
+                        // Shown by ShowValidation when the check finishes
+                        Validator.Request(CurrentState);
+                        LastValidation = "Checking";
+                    }
+                    BaseDisplayManager.drawSquares(std::bitset<81>());
+                });
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX+1*width/2 + border,offsetY + itemCount*(lineHeight + itemBorder)),Size<uint16_t>(1*width/2 - border,lineHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return LastValidation; }
+                , []( TextBuffer& text ) { text << LastValidation.c_str(); }
                 , []() -> bool { return false; } 
-                , nullptr));
+                , nullptr);
             itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX + border,offsetY + itemCount*(lineHeight + itemBorder)),Size<uint16_t>(1*width/2 - border,lineHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "New Game"; }
+                , []( TextBuffer& text ) { text << "New Game"; }
                 , []() -> bool { return true; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]()
+                , [this]()
                 {
                     this->ShowNewGameDialog();
-                })));
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+                });
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX+width/2 + border,offsetY + itemCount*(lineHeight + itemBorder)),Size<uint16_t>(1*width/2 - border,lineHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return !CurrentState.Solved() ? "Clue" : ""; }
+                , []( TextBuffer& text ) { text << (!CurrentState.Solved() ? "Clue" : ""); }
                 , []() -> bool { return !CurrentState.Solved() ? true : false; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([]()
+                , []()
                 {
-                    CurrentState.FixOneSquare();
-                    LastValidation = "";
-                    BaseDisplayManager.draw();
-                })));
+                    SudokuState before = CurrentState;
+                    CurrentState.FixOneSquare(SudokuState::eHintLogical);
+                    Journal.RecordDiff(CurrentState, before);
+                    LastValidation.clear();
+                    BaseDisplayManager.drawSquares(CurrentState.ChangedSquares(before));
+                });
             itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX+width/2 + border,offsetY + itemCount*(lineHeight + itemBorder)),Size<uint16_t>(width/2 - border,lineHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "Save"; }
+                , []( TextBuffer& text ) { text << "Save"; }
                 , []() -> bool { return true; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([]()
+                , []()
                 {
                     CurrentState.Save();
                     BaseDisplayManager.draw();
-                })));
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+                });
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX + border,offsetY + itemCount*(lineHeight + itemBorder)),Size<uint16_t>(width/2 - border,lineHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return SudokuState::HasSave() ? "Load" : ""; }
-                , []() -> bool { return SudokuState::HasSave() ? true : false; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([]()
+                , []( TextBuffer& text ) { text << "Games"; }
+                , []() -> bool { return true; } 
+                , [this]()
                 {
-                    if( SudokuState::HasSave() )
+                    this->ShowLoadGameDialog();
+                });
+
+        }
+        break;
+    case eLayout::eLoadGame:
+        cached.Rotation = 0;
+        cached.CanvasPos = {120,64};
+        cached.CanvasSize = {960-120*2,540-64*2};
+        cached.ClearScreen = false;
+        {
+            Rect<uint16_t> canvasRect{{0,0},cached.CanvasSize};
+            items.add<LayoutItem_Rectangle>(canvasRect);
+            items.add<LayoutItem_Rectangle>(canvasRect.shrinkBy({5,5}));
+            items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10),Size<uint16_t>(cached.CanvasSize.cx-40,56)),&FreeSansBold24pt7b,TC_DATUM,"Saved Games");
+
+            uint16_t border = 32;
+            uint16_t offsetY = 10+56;
+            uint16_t lineHeight = 38;
+            uint16_t itemBorder = 4;
+            for( uint8_t slot = 0 ; slot < SaveIndexBlob::MaxSlots ; slot++ )
+                items.add<LayoutItem_DynamicText>(
+                    Rect<uint16_t>(Point<uint16_t>(border,offsetY + slot*(lineHeight + itemBorder)),Size<uint16_t>(cached.CanvasSize.cx - 2*border,lineHeight))
+                    , &FreeSans12pt7b, CL_DATUM
+                    , [slot]( TextBuffer& text ) { Saves.Describe(slot, text); }
+                    , [slot]() -> bool { return slot == Saves.GetCurrent(); } 
+                    , [this,slot]()
                     {
-                        CurrentState.Load();
-                        LastValidation = "";
-                        BaseDisplayManager.draw(true);
-                    }
-                })));
+                        if( Saves.GetInfo(slot).InUse() )
+                        {
+                            this->SelectedSlot = slot;
+                            this->ShouldClose = true;
+                        }
+                    });
+
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - 200,cached.CanvasSize.cy-84),Size<uint16_t>(180, 64))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Cancel"; }
+                , []() -> bool { return true; } 
+                , [this]()
+                {
+                    this->Cancelled = true;
+                    this->ShouldClose = true;
+                });
+        }
+        break;
+    case eLayout::eCollection:
+        cached.Rotation = 0;
+        cached.CanvasPos = {120,64};
+        cached.CanvasSize = {960-120*2,540-64*2};
+        cached.ClearScreen = false;
+        {
+            Rect<uint16_t> canvasRect{{0,0},cached.CanvasSize};
+            items.add<LayoutItem_Rectangle>(canvasRect);
+            items.add<LayoutItem_Rectangle>(canvasRect.shrinkBy({5,5}));
+            items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10),Size<uint16_t>(cached.CanvasSize.cx-40,56)),&FreeSansBold24pt7b,TC_DATUM,"Puzzle Collection");
 
+            uint16_t border = 32;
+            uint16_t width = cached.CanvasSize.cx - border*2;
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(border,80),Size<uint16_t>(width,48))
+                , &FreeSansBold12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Puzzle " << CollectionNumber+1 << " of " << Collection.GetCount(); });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(border,128),Size<uint16_t>(width,48))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << DescribeCollectionPuzzle(); });
+
+            // Steps to move through the collection, back on the left and forward on the right
+            const int16_t steps[] = { -1000, -100, -10, -1, 1, 10, 100, 1000 };
+            const uint8_t stepCount = sizeof(steps)/sizeof(steps[0]);
+            uint16_t itemBorder = 8;
+            uint16_t itemWidth = (width - itemBorder*(stepCount-1))/stepCount;
+            for( uint8_t i = 0 ; i < stepCount ; i++ )
+            {
+                int16_t step = steps[i];
+                items.add<LayoutItem_DynamicText>(
+                    Rect<uint16_t>(Point<uint16_t>(border + i*(itemWidth+itemBorder),200),Size<uint16_t>(itemWidth,56))
+                    , &FreeSans12pt7b, CC_DATUM
+                    , [step]( TextBuffer& text ) { if( step > 0 ) text << '+'; text << step; }
+                    , []() -> bool { return true; }
+                    , [this,step]() { StepCollection(step); this->draw(); } );
+            }
+
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(border,cached.CanvasSize.cy-84),Size<uint16_t>(180, 64))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Random"; }
+                , []() -> bool { return true; }
+                , [this]()
+                {
+                    if( Collection.GetCount() )
+                        CollectionNumber = g_() % Collection.GetCount();
+                    this->draw();
+                });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - 400,cached.CanvasSize.cy-84),Size<uint16_t>(180, 64))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Cancel"; }
+                , []() -> bool { return true; }
+                , [this]()
+                {
+                    this->Cancelled = true;
+                    this->ShouldClose = true;
+                });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - 200,cached.CanvasSize.cy-84),Size<uint16_t>(180, 64))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Play"; }
+                , []() -> bool { return true; }
+                , [this]()
+                {
+                    // Only a puzzle with one solution can be played
+                    SudokuState check;
+                    if( Collection.Load(CollectionNumber, check) )
+                        this->ShouldClose = true;
+                });
+        }
+        break;
+    case eLayout::eDiagnostics:
+        cached.Rotation = 0;
+        cached.CanvasPos = {0,0};
+        cached.CanvasSize = {960,540};
+        cached.ClearScreen = false;
+        {
+            Rect<uint16_t> canvasRect{{0,0},cached.CanvasSize};
+            items.add<LayoutItem_Rectangle>(canvasRect);
+            items.add<LayoutItem_Rectangle>(canvasRect.shrinkBy({5,5}));
+            items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10),Size<uint16_t>(cached.CanvasSize.cx-40,56)),&FreeSansBold24pt7b,TC_DATUM,"Diagnostics");
+
+            uint16_t border = 40;
+            uint16_t columnWidth = (cached.CanvasSize.cx - 3*border) / 2;
+            uint16_t offsetY = 80;
+            uint16_t lineHeight = 32;
+            for( uint8_t i = 0 ; i < PerfStats::eCounterCount ; i++ )
+                items.add<LayoutItem_DynamicText>(
+                    Rect<uint16_t>(Point<uint16_t>(border,offsetY + i*lineHeight),Size<uint16_t>(columnWidth,lineHeight))
+                    , &FreeSans9pt7b, CL_DATUM
+                    , [i]( TextBuffer& text ) { Perf.Describe((PerfStats::eCounter)i, text); });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(border,offsetY + PerfStats::eCounterCount*lineHeight),Size<uint16_t>(columnWidth,lineHeight))
+                , &FreeSans9pt7b, CL_DATUM
+                , []( TextBuffer& text )
+                {
+                    const InputManager::LatencyStats& latency = Input.GetLatency();
+                    text << "Input latency: " << latency.Count << ", mean " << (latency.Count ? (uint32_t)(latency.TotalUS / latency.Count) : 0) << "us, max " << latency.MaxUS << "us";
+                });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(border,offsetY + (PerfStats::eCounterCount+1)*lineHeight),Size<uint16_t>(columnWidth,lineHeight))
+                , &FreeSans9pt7b, CL_DATUM
+                , []( TextBuffer& text ) { text << "Heap: " << ESP.getFreeHeap() << " free, " << ESP.getMinFreeHeap() << " min, " << ESP.getMaxAllocHeap() << " largest"; });
+            for( uint8_t i = 0 ; i < PerfStats::eTimerCount ; i++ )
+                items.add<LayoutItem_DynamicText>(
+                    Rect<uint16_t>(Point<uint16_t>(2*border + columnWidth,offsetY + i*lineHeight),Size<uint16_t>(columnWidth,lineHeight))
+                    , &FreeSans9pt7b, CL_DATUM
+                    , [i]( TextBuffer& text ) { Perf.Describe((PerfStats::eTimer)i, text); });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(2*border + columnWidth,offsetY + PerfStats::eTimerCount*lineHeight),Size<uint16_t>(columnWidth,lineHeight))
+                , &FreeSans9pt7b, CL_DATUM
+                , []( TextBuffer& text ) { text << "PSRAM: " << ESP.getFreePsram() << " free, scratch " << Scratch.GetHighWater() << "/" << Scratch.GetSize(); });
+
+            uint16_t buttonWidth = 180;
+            uint16_t buttonTop = cached.CanvasSize.cy - 74;
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - 3*(buttonWidth+20),buttonTop),Size<uint16_t>(buttonWidth, 56))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Reset"; }
+                , []() -> bool { return true; } 
+                , [this]()
+                {
+                    Perf.Reset();
+                    this->draw();
+                });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - 2*(buttonWidth+20),buttonTop),Size<uint16_t>(buttonWidth, 56))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Serial CSV"; }
+                , []() -> bool { return true; } 
+                , []()
+                {
+                    Perf.DumpCsv();
+                });
+            items.add<LayoutItem_DynamicText>(
+                Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - (buttonWidth+20),buttonTop),Size<uint16_t>(buttonWidth, 56))
+                , &FreeSans12pt7b, CC_DATUM
+                , []( TextBuffer& text ) { text << "Close"; }
+                , []() -> bool { return true; } 
+                , [this]()
+                {
+                    this->ShouldClose = true;
+                });
+        }
+        break;
+    case eLayout::eShutdown:
+        cached.Rotation = 0;
+        cached.CanvasSize = {400,400};
+        cached.Centred = true;
+        cached.ClearScreen = false;
+        {
+            Rect<uint16_t> canvasRect{{0,0},cached.CanvasSize};
+            items.add<LayoutItem_Rectangle>(canvasRect);
+            items.add<LayoutItem_Rectangle>(canvasRect.shrinkBy({5,5}));
+            items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,50),Size<uint16_t>(cached.CanvasSize.cx-40,64)),&FreeSansBold24pt7b,TC_DATUM,"Shutdown");
+            items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,200),Size<uint16_t>(cached.CanvasSize.cx-40,40)),&FreeSansBold18pt7b,TC_DATUM,"Hold side button");
+            items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,240),Size<uint16_t>(cached.CanvasSize.cx-40,40)),&FreeSansBold18pt7b,TC_DATUM,"to restart");
         }
         break;
     case eLayout::eNewGame:
-        Rotation = 0 + (flip?180:0);
-        CanvasPos = {120,64};
-        CanvasSize = {960-120*2,540-64*2};
-        Rect<uint16_t> canvasRect{{0,0},CanvasSize};
+        cached.Rotation = 0;
+        cached.CanvasPos = {120,64};
+        cached.CanvasSize = {960-120*2,540-64*2};
+        Rect<uint16_t> canvasRect{{0,0},cached.CanvasSize};
 
-        clearCanvas = false;
+        cached.ClearScreen = false;
 
-        LayoutItems.push_back( std::make_shared<LayoutItem_Rectangle>(canvasRect) );
-        LayoutItems.push_back( std::make_shared<LayoutItem_Rectangle>(canvasRect.shrinkBy({5,5})) );
-        LayoutItems.push_back( std::make_shared<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10),Size<uint16_t>(CanvasSize.cx-40,64)),&FreeSansBold24pt7b,TC_DATUM,String("New Game"),nullptr) );
+        items.add<LayoutItem_Rectangle>(canvasRect);
+        items.add<LayoutItem_Rectangle>(canvasRect.shrinkBy({5,5}));
+        items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10),Size<uint16_t>(cached.CanvasSize.cx-40,64)),&FreeSansBold24pt7b,TC_DATUM,"New Game");
 
-        LayoutItems.push_back( std::make_shared<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10+64),Size<uint16_t>(CanvasSize.cx-40,64)),&FreeSansBold12pt7b,TC_DATUM,String("Target Clues"),nullptr) );
+        items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10+64),Size<uint16_t>(cached.CanvasSize.cx-40,64)),&FreeSansBold12pt7b,TC_DATUM,"Difficulty");
+        items.add<LayoutItem_DynamicText>(
+            Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx-32-140,64),Size<uint16_t>(140, 48))
+            , &FreeSans12pt7b, CC_DATUM
+            , []( TextBuffer& text ) { text << "Instant"; }
+            , []() -> bool { return InstantGames; } 
+            , [this]() { InstantGames = !InstantGames; TargetFixedCells = 0; this->draw(); } );
+        items.add<LayoutItem_DynamicText>(
+            Rect<uint16_t>(Point<uint16_t>(32,64),Size<uint16_t>(160, 48))
+            , &FreeSans12pt7b, CC_DATUM
+            , []( TextBuffer& text ) { if( Collection.IsOpen() ) text << "Collection"; }
+            , []() -> bool { return Collection.IsOpen(); }
+            , [this]()
+            {
+                // Picking a puzzle there starts it, so this dialog has nothing more to do
+                if( Collection.IsOpen() && this->ShowCollectionDialog() )
+                {
+                    this->Cancelled = true;
+                    this->ShouldClose = true;
+                }
+            });
         {
             uint16_t border = 32;
-            uint16_t width = CanvasSize.cx - border*2;
+            uint16_t width = cached.CanvasSize.cx - border*2;
             uint16_t offsetX = border;
             uint16_t offsetY = 128-8;
             uint16_t itemBorder = 32;
             uint16_t itemWidth = (width - itemBorder*3)/4;
             uint16_t itemHeight = 64;
-            uint16_t itemCount = 0;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
-                Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
-                , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "22"; }
-                , []() -> bool { return TargetFixedCells == 22; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetFixedCells = 22; this->draw(); } )));
-            itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
-                Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
-                , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "24"; }
-                , []() -> bool { return TargetFixedCells == 24; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetFixedCells = 24; this->draw(); } )));
-            itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
-                Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
-                , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "26"; }
-                , []() -> bool { return TargetFixedCells == 26; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetFixedCells = 26; this->draw(); } )));
-            itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
-                Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
-                , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "28"; }
-                , []() -> bool { return TargetFixedCells == 28; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetFixedCells = 28; this->draw(); } )));
+            for( uint8_t i = 0 ; i < DifficultyBand::eLevelCount ; i++ )
+            {
+                DifficultyBand::eLevel level = (DifficultyBand::eLevel)i;
+                items.add<LayoutItem_DynamicText>(
+                    Rect<uint16_t>(Point<uint16_t>(offsetX + i*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
+                    , &FreeSans12pt7b, CC_DATUM
+                    , [level]( TextBuffer& text ) { text << DifficultyBand::Name(level); }
+                    , [level]() -> bool { return TargetFixedCells == 0 && TargetLevel == level; } 
+                    , [this,level]() { TargetLevel = level; TargetFixedCells = 0; this->draw(); } );
+            }
         }
 
-        LayoutItems.push_back( std::make_shared<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10+128+64),Size<uint16_t>(CanvasSize.cx-40,64)),&FreeSansBold12pt7b,TC_DATUM,String("Time to Find"),nullptr) );
+        items.add<LayoutItem_StaticText>(Rect<uint16_t>(Point<uint16_t>(20,10+128+64),Size<uint16_t>(cached.CanvasSize.cx-40,64)),&FreeSansBold12pt7b,TC_DATUM,"Or Target Clues");
         {
             uint16_t border = 32;
-            uint16_t width = CanvasSize.cx - border*2;
+            uint16_t width = cached.CanvasSize.cx - border*2;
             uint16_t offsetX = border;
             uint16_t offsetY = 256-16;
             uint16_t itemBorder = 32;
             uint16_t itemWidth = (width - itemBorder*3)/4;
             uint16_t itemHeight = 64;
             uint16_t itemCount = 0;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "30s"; }
-                , []() -> bool { return TargetSolveTimeMS == 30*1000; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetSolveTimeMS = 30*1000; this->draw(); } )));
+                , []( TextBuffer& text ) { text << "22"; }
+                , []() -> bool { return TargetFixedCells == 22; } 
+                , [this]() { TargetFixedCells = 22; this->draw(); } );
             itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "60s"; }
-                , []() -> bool { return TargetSolveTimeMS == 60*1000; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetSolveTimeMS = 60*1000; this->draw(); } )));
+                , []( TextBuffer& text ) { text << "24"; }
+                , []() -> bool { return TargetFixedCells == 24; } 
+                , [this]() { TargetFixedCells = 24; this->draw(); } );
             itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "90s"; }
-                , []() -> bool { return TargetSolveTimeMS == 90*1000; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetSolveTimeMS = 90*1000; this->draw(); } )));
+                , []( TextBuffer& text ) { text << "26"; }
+                , []() -> bool { return TargetFixedCells == 26; } 
+                , [this]() { TargetFixedCells = 26; this->draw(); } );
             itemCount++;
-            LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
+            items.add<LayoutItem_DynamicText>(
                 Rect<uint16_t>(Point<uint16_t>(offsetX + itemCount*(itemWidth+itemBorder),offsetY),Size<uint16_t>(itemWidth,itemHeight))
                 , &FreeSans12pt7b, CC_DATUM
-                , []() -> String { return "120s"; }
-                , []() -> bool { return TargetSolveTimeMS == 120*1000; } 
-                , std::make_shared<LayoutItemAction_StdFunction>([this]() { TargetSolveTimeMS = 120*1000; this->draw(); } )));
+                , []( TextBuffer& text ) { text << "28"; }
+                , []() -> bool { return TargetFixedCells == 28; } 
+                , [this]() { TargetFixedCells = 28; this->draw(); } );
         }
 
-        LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
-            Rect<uint16_t>(Point<uint16_t>(CanvasSize.cx - 400,CanvasSize.cy-84),Size<uint16_t>(180, 64))
+        items.add<LayoutItem_DynamicText>(
+            Rect<uint16_t>(Point<uint16_t>(32,cached.CanvasSize.cy-84),Size<uint16_t>(240, 64))
             , &FreeSans12pt7b, CC_DATUM
-            , []() -> String { return "Cancel"; }
+            , []( TextBuffer& text ) { text << "Auto marks"; }
+            , []() -> bool { return AutoCandidates; } 
+            , [this]() { AutoCandidates = !AutoCandidates; this->draw(); } );
+
+        items.add<LayoutItem_DynamicText>(
+            Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - 400,cached.CanvasSize.cy-84),Size<uint16_t>(180, 64))
+            , &FreeSans12pt7b, CC_DATUM
+            , []( TextBuffer& text ) { text << "Cancel"; }
             , []() -> bool { return true; } 
-            , std::make_shared<LayoutItemAction_StdFunction>([this]()
+            , [this]()
             {
                 this->Cancelled = true;
                 this->ShouldClose = true;
-            })));
+            });
 
-        LayoutItems.push_back( std::make_shared<LayoutItem_DynamicText>(
-            Rect<uint16_t>(Point<uint16_t>(CanvasSize.cx - 200,CanvasSize.cy-84),Size<uint16_t>(180, 64))
+        items.add<LayoutItem_DynamicText>(
+            Rect<uint16_t>(Point<uint16_t>(cached.CanvasSize.cx - 200,cached.CanvasSize.cy-84),Size<uint16_t>(180, 64))
             , &FreeSans12pt7b, CC_DATUM
-            , []() -> String { return "Go"; }
+            , []( TextBuffer& text ) { text << "Go"; }
             , []() -> bool { return true; } 
-            , std::make_shared<LayoutItemAction_StdFunction>([this]()
+            , [this]()
             {
                 this->ShouldClose = true;
-            })));
+            });
 
         break;
     }
 
-    CurrentLayout = layout;
-
-    Rotation = Rotation % 360;
-    log_d("New rotation %d",Rotation);
-
-    M5.TP.SetRotation(Rotation);
-    M5.EPD.SetRotation(Rotation);
-    if( clearCanvas )
-        M5.EPD.Clear(true);
-
-    log_d("Canvas size (%d,%d) at (%d,%d)", CanvasSize.cx, CanvasSize.cy, CanvasPos.x, CanvasPos.y);
-    Canvas.createCanvas(CanvasSize.cx,CanvasSize.cy);
+    items.build(cached.CanvasSize);
 }
 
-void DisplayManager::drawString( const GFXfont* font, uint8_t datum, String str, const Rect<uint16_t>& rect )
+void DisplayManager::drawString( const GFXfont* font, uint8_t datum, const char* str, const Rect<uint16_t>& rect )
 {
     switch( datum )
     {
@@ -346,252 +686,623 @@ void DisplayManager::drawString( const GFXfont* font, uint8_t datum, String str,
     }
 }
 
-void DisplayManager::drawString( const GFXfont* font, uint8_t datum, String str, uint32_t x, uint32_t y )
+void DisplayManager::drawString( const GFXfont* font, uint8_t datum, const char* str, uint32_t x, uint32_t y )
 {
     if( font )
-        Canvas.setFreeFont(font);
-    Canvas.setTextDatum(datum);
-    Canvas.drawString(str, x, y);
+        Canvas->setFreeFont(font);
+    Canvas->setTextDatum(datum);
+    Canvas->drawString(str, x, y);
 }
 
 void DisplayManager::draw( bool bFullRedraw ) 
 {
-    DesiredUpdateRect = Rect<uint16_t>{0,0,0,0};
-    DesiredUpdateMode = UPDATE_MODE_NONE;
-
-    if( bFullRedraw )
-        clearScreen();
-
     Rect<uint16_t> redrawRect{0,0,0,0};
-    for( auto& item : LayoutItems )
     {
-        if( !item.get( ))
-            continue;
+        DisplayLock lock;
+        PERF_SCOPE(eTimerDraw);
+        PERF_HEAP_CHECK();
+
+        if( bFullRedraw )
+            clearScreen();
+
+        ShownMistakes = CurrentState.FindMistakes();
+        for( auto& entry : *LayoutItems )
         {
-            item->draw( *this );
+            entry.Item->draw( *this );
+            PERF_COUNT(eItemsPainted);
             if( redrawRect.width() == 0 )
-                redrawRect = item->Location;
+                redrawRect = entry.Location;
             else
-                redrawRect = redrawRect.outersect(item->Location);
+                redrawRect = redrawRect.outersect(entry.Location);
         }
     }
 //    log_i("Redraw rect = (%d,%d,%d,%d)",redrawRect.left,redrawRect.top,redrawRect.right,redrawRect.bottom);
     if( bFullRedraw )
+        invalidate(Rect<uint16_t>({0,0},CanvasSize), UPDATE_MODE_GC16);
+    else if( DirtyMode == UPDATE_MODE_NONE && redrawRect.width() > 0 )
+        invalidate(redrawRect, UPDATE_MODE_DU4);
+    flush();
+}
+
+void DisplayManager::drawSquares( std::bitset<81> squares )
+{
+    Rect<uint16_t> board;
+    for( auto& entry : *LayoutItems )
+        if( entry.Item->boardSquare() >= 0 )
+            board = board.empty() ? entry.Location : board.outersect(entry.Location);
+    if( board.empty() )
     {
-//        log_i("New track");
-        DesiredUpdateRect = Rect<uint16_t>(CanvasPos,CanvasSize);
-        DesiredUpdateMode = UPDATE_MODE_GC16;
-    }
-    else if( redrawRect.width() > 0 )
-    {
-//        log_i("Have redraw rect");
-        DesiredUpdateRect = redrawRect;
-        DesiredUpdateMode = UPDATE_MODE_DU4;
+        draw();
+        return;
     }
 
-    if( DesiredUpdateMode != UPDATE_MODE_NONE )
+    std::bitset<81> mistakes = CurrentState.FindMistakes();
+    squares |= mistakes ^ ShownMistakes;
+    render();
+
+    // Each square on its own, so two squares far apart do not send everything in between
+    for( auto& entry : *LayoutItems )
     {
-//        log_i("Delayed update");
-        M5.EPD.WritePartGram4bpp(CanvasPos.x, CanvasPos.y, CanvasSize.cx, CanvasSize.cy, (uint8_t*)Canvas.frameBuffer());
-        if( !PopupDialogActive )
+        int8_t square = entry.Item->boardSquare();
+        if( square >= 0 && squares[square] )
         {
-//            log_i("Delayed update - no popup");
-            M5.EPD.UpdateArea(CanvasPos.x, CanvasPos.y, CanvasSize.cx, CanvasSize.cy, DesiredUpdateMode);
-            DesiredUpdateMode = UPDATE_MODE_NONE;
+            invalidate(entry.Location, UPDATE_MODE_DU4);
+            flush();
         }
     }
-    if( this != &BaseDisplayManager && BaseDisplayManager.DesiredUpdateMode != UPDATE_MODE_NONE )
+    Rect<uint16_t> others;
+    for( auto& entry : *LayoutItems )
+        if( entry.Item->boardSquare() < 0 && !board.overlaps(entry.Location) )
+            others = others.empty() ? entry.Location : others.outersect(entry.Location);
+    if( !others.empty() )
     {
-//        log_i("Delayed update - not base");
-        M5.EPD.WritePartGram4bpp(BaseDisplayManager.CanvasPos.x, BaseDisplayManager.CanvasPos.y, BaseDisplayManager.CanvasSize.cx, BaseDisplayManager.CanvasSize.cy, (uint8_t*)BaseDisplayManager.Canvas.frameBuffer());
-        M5.EPD.WritePartGram4bpp(CanvasPos.x, CanvasPos.y, CanvasSize.cx, CanvasSize.cy, (uint8_t*)Canvas.frameBuffer());
-        Rect<uint16_t> updateRect = Rect<uint16_t>{CanvasPos,CanvasSize}.outersect(BaseDisplayManager.DesiredUpdateRect);        
-        M5.EPD.UpdateArea(updateRect.left, updateRect.top, updateRect.right, updateRect.bottom, BaseDisplayManager.DesiredUpdateMode);
-        BaseDisplayManager.DesiredUpdateMode = UPDATE_MODE_NONE;
-    }    
+        invalidate(others, UPDATE_MODE_DU4);
+        flush();
+    }
 }
 
 void DisplayManager::redraw()
 {
-    for( auto& item : LayoutItems )
+    render();
+    refreshScreen(UPDATE_MODE_GC16);
+}
+
+void DisplayManager::render()
+{
+    DisplayLock lock;
+    PERF_SCOPE(eTimerDraw);
+    PERF_HEAP_CHECK();
+    ShownMistakes = CurrentState.FindMistakes();
+    for( auto& entry : *LayoutItems )
     {
-        if( !item.get( ))
-            continue;
-        item->draw( *this );
+        entry.Item->draw( *this );
+        PERF_COUNT(eItemsPainted);
     }
-    refreshScreen(UPDATE_MODE_GC16);
+}
+
+uint32_t DisplayManager::canvasCrc() const
+{
+    DisplayLock lock;
+    return Crc32(Canvas->frameBuffer(), CanvasSize.cx * CanvasSize.cy / 2);
 }
 
 void DisplayManager::clearScreen()
 {
-    Canvas.fillCanvas(0);
+    Canvas->fillCanvas(0);
 }
 
 void DisplayManager::refreshScreen( m5epd_update_mode_t mode )
 {
-    Canvas.pushCanvas(CanvasPos.x,CanvasPos.y,mode);
+    invalidate(Rect<uint16_t>({0,0},CanvasSize), mode);
+    flush();
 }
 
 void DisplayManager::drawRect( const Rect<uint16_t>& rect, uint32_t colour )
 {
-    Canvas.drawRect(rect.left,rect.top,rect.width(),rect.height(),colour);
+    Canvas->drawRect(rect.left,rect.top,rect.width(),rect.height(),colour);
 }
 void DisplayManager::fillRect( const Rect<uint16_t>& rect, uint32_t colour )
 {
-    Canvas.fillRect(rect.left,rect.top,rect.width(),rect.height(),colour);
+    Canvas->fillRect(rect.left,rect.top,rect.width(),rect.height(),colour);
+}
+// Lower ranks can be merged into higher ones without losing quality
+static uint8_t UpdateModeRank( m5epd_update_mode_t mode )
+{
+    switch( mode )
+    {
+        case UPDATE_MODE_NONE:  return 0;
+        case UPDATE_MODE_A2:    return 1;
+        case UPDATE_MODE_DU:    return 2;
+        case UPDATE_MODE_DU4:   return 3;
+        case UPDATE_MODE_GL16:  return 4;
+        default:                return 5;
+    }
+}
+
+void DisplayManager::invalidate( const Rect<uint16_t>& rect, m5epd_update_mode_t mode )
+{
+    if( DirtyMode == UPDATE_MODE_NONE )
+        DirtyRect = rect;
+    else
+        DirtyRect = DirtyRect.outersect(rect);
+    if( UpdateModeRank(mode) > UpdateModeRank(DirtyMode) )
+        DirtyMode = mode;
+}
+
+void DisplayManager::flush()
+{
+    if( DirtyMode == UPDATE_MODE_NONE )
+        return;
+    Rect<uint16_t> area = DirtyRect.add(CanvasPos);
+    m5epd_update_mode_t mode = DirtyMode;
+    DirtyRect = Rect<uint16_t>();
+    DirtyMode = UPDATE_MODE_NONE;
+
+    {
+        DisplayLock lock;
+        // Changes hidden behind a higher layer do not need sending
+        bool above = false;
+        for( uint8_t i = 0 ; i < LayerCount && !area.empty() ; i++ )
+            if( Layers[i] == this )
+                above = true;
+            else if( above )
+                area = area.uncovered(Layers[i]->screenRect());
+    }
+    if( !area.empty() )
+        queueScreenUpdate(area, mode);
+}
+
+void DisplayManager::ShowLayer()
+{
+    DisplayLock lock;
+    for( uint8_t i = 0 ; i < LayerCount ; i++ )
+        if( Layers[i] == this )
+            return;
+    if( LayerCount < MaxLayers )
+        Layers[LayerCount++] = this;
+}
+
+void DisplayManager::HideLayer( m5epd_update_mode_t mode )
+{
+    {
+        DisplayLock lock;
+        auto end = std::remove(Layers, Layers + LayerCount, this);
+        if( end == Layers + LayerCount )
+            return;
+        LayerCount = end - Layers;
+    }
+    // Uncover whatever was underneath
+    queueScreenUpdate(screenRect(), mode);
+}
+
+void DisplayManager::queueScreenUpdate( Rect<uint16_t> area, m5epd_update_mode_t updateMode )
+{
+    if( updateMode == UPDATE_MODE_NONE || area.empty() )
+        return;
+
+    // The panel takes 4bpp data four pixels at a time
+    area.left &= ~3;
+    area.right = (area.right + 3) & ~3;
+
+    DisplayUpdate update;
+    update.Area = area;
+    update.Mode = updateMode;
+
+    PendingUpdates++;
+    if( !UpdateQueue )
+    {
+        ProcessUpdate(update);
+        PendingUpdates--;
+        return;
+    }
+    xQueueSend(UpdateQueue, &update, portMAX_DELAY);
+}
+
+void DisplayManager::StartDisplayTask()
+{
+    if( UpdateQueue )
+        return;
+    ComposeBuffer = (uint8_t*)heap_caps_malloc(960*540/2, MALLOC_CAP_SPIRAM);
+    if( !ComposeBuffer )
+        ComposeBuffer = (uint8_t*)malloc(960*540/2);
+    Mutex = xSemaphoreCreateRecursiveMutex();
+    UpdateQueue = xQueueCreate(16, sizeof(DisplayUpdate));
+    xTaskCreatePinnedToCore(DisplayTask, "Display", 4*1024, nullptr, 2, nullptr, 0);
+}
+
+void DisplayManager::WaitForDisplayIdle()
+{
+    while( PendingUpdates > 0 )
+        vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+void DisplayManager::DisplayTask( void* )
+{
+    constexpr uint8_t maxPending = 8;
+    DisplayUpdate pending[maxPending];
+    while( true )
+    {
+        uint8_t count = 0;
+        uint32_t received = 0;
+        DisplayUpdate update;
+        if( xQueueReceive(UpdateQueue, &update, portMAX_DELAY) != pdTRUE )
+            continue;
+
+        // Wait for the panel to finish the previous refresh, so that anything queued
+        // meanwhile (e.g. rapid taps) can be folded into the next one
+        M5.EPD.CheckAFSR();
+        do
+        {
+            received++;
+            bool merged = false;
+            for( uint8_t i = 0 ; i < count && !merged ; i++ )
+            {
+                if( !pending[i].Area.overlaps(update.Area) )
+                    continue;
+                pending[i].Area = pending[i].Area.outersect(update.Area);
+                if( UpdateModeRank(update.Mode) > UpdateModeRank(pending[i].Mode) )
+                    pending[i].Mode = update.Mode;
+                merged = true;
+            }
+            if( !merged )
+            {
+                if( count == maxPending )
+                {
+                    ProcessUpdate(pending[0]);
+                    std::copy(pending+1, pending+count, pending);
+                    count--;
+                }
+                pending[count++] = update;
+            }
+        } while( xQueueReceive(UpdateQueue, &update, 0) == pdTRUE );
+
+//        log_d("Display task merged %d requests into %d updates", received, count);
+        uint32_t start = PerfStats::Cycles();
+        m5epd_update_mode_t slowest = UPDATE_MODE_NONE;
+        for( uint8_t i = 0 ; i < count ; i++ )
+        {
+            ProcessUpdate(pending[i]);
+            if( slowest == UPDATE_MODE_NONE || UpdateModeRank(pending[i].Mode) > UpdateModeRank(slowest) )
+                slowest = pending[i].Mode;
+        }
+        // Waiting here rather than for the next request lets the refresh be timed
+        M5.EPD.CheckAFSR();
+        PERF_RECORD(PerfStats::EpdTimer(slowest), PerfStats::Cycles() - start);
+        PendingUpdates -= received;
+    }
 }
-void DisplayManager::M5EPD_flushAndUpdateArea( const Rect<uint16_t>& rect, m5epd_update_mode_t updateMode )
+
+void DisplayManager::ProcessUpdate( const DisplayUpdate& update )
 {
-    M5.EPD.WriteFullGram4bpp((uint8_t*)Canvas.frameBuffer());
-    M5.EPD.UpdateArea(rect.left, rect.top, rect.width(), rect.height(),updateMode);
-} 
+    DisplayLock lock;
+    PERF_SCOPE(eTimerCompose);
+
+    const Rect<uint16_t>& area = update.Area;
+    uint16_t stride = area.width() / 2;
+    PERF_ADD(eGramBytes, stride * area.height());
+
+    // Layers below one that covers the whole area cannot be seen
+    int8_t first = LayerCount - 1;
+    while( first > 0 && !Layers[first]->screenRect().contains(area) )
+        first--;
+    if( first < 0 || !Layers[first]->screenRect().contains(area) )
+        memset(ComposeBuffer, 0, stride * area.height());
+
+    for( int8_t i = max<int8_t>(first,0) ; i < LayerCount ; i++ )
+    {
+        DisplayManager* layer = Layers[i];
+        Rect<uint16_t> part = area.intersect(layer->screenRect());
+        if( part.empty() )
+            continue;
+        uint16_t layerStride = layer->CanvasSize.cx / 2;
+        const uint8_t* src = (const uint8_t*)layer->Canvas->frameBuffer()
+            + (part.top - layer->CanvasPos.y) * layerStride + (part.left - layer->CanvasPos.x) / 2;
+        uint8_t* dst = ComposeBuffer + (part.top - area.top) * stride + (part.left - area.left) / 2;
+        for( uint16_t y = part.top ; y < part.bottom ; y++, src += layerStride, dst += stride )
+            memcpy(dst, src, part.width() / 2);
+    }
+
+    M5.EPD.WritePartGram4bpp(area.left, area.top, area.width(), area.height(), ComposeBuffer);
+    M5.EPD.UpdateArea(area.left, area.top, area.width(), area.height(), update.Mode);
+}
 
 void DisplayManager::doLoop( bool enableButtons )
 {
-    //vTaskDelay(1);
     static uint32_t lastActive = millis();
     static uint32_t inactivityTimeout = 5 * 60 * 1000;
 
     auto ts = millis();
-    if( ts > lastActive + inactivityTimeout )
+    if( ts - lastActive >= inactivityTimeout )
     {
-        Rect<uint16_t> voltRect(CanvasSize.cx-60,0,CanvasSize.cx,60);
-        fillRect(voltRect,0);
-        drawString(&FreeSans9pt7b,BL_DATUM,String(M5.getBatteryVoltage()/1000.0), voltRect);
-        M5EPD_flushAndUpdateArea(voltRect,UPDATE_MODE_GC16);
         doShutdownIfOnBattery();
         lastActive = ts;
     }
 
+    if( Validator.TakeFinished() )
+        ShowValidation();
+
+    // Sleeps until there is input, or it is time to check for inactivity again.
+    // The check above can take long enough that the time is already up.
+    uint32_t inactiveMS = millis() - lastActive;
+    uint8_t events = Input.WaitForEvent(inactiveMS < inactivityTimeout ? inactivityTimeout - inactiveMS : 0);
+    // Woken for background work, which is picked up at the top of the next loop
+    if( (events & ~InputManager::eWake) == InputManager::eNone )
+        return;
+
     // Prevent repeated press detection
     static bool wasFingerDown = false;
-//    static bool wasButtonPressed = false;
-
-    M5.update();
-//    if (enableButtons && !wasButtonPressed && M5.BtnL.wasPressed()) {
-//        log_i("BtnL - Previous");
-//        wasButtonPressed = true;
-//        HandleButtonL();
-//    }
-//    else if (enableButtons && !wasButtonPressed && M5.BtnP.wasPressed()) {
-//        log_i("BtnP - Toggle");
-//        wasButtonPressed = true;
-//        HandleButtonP();
-//    }
-//    else if (enableButtons && !wasButtonPressed && M5.BtnR.wasPressed()) {
-//        log_i("BtnR - Next");
-//        wasButtonPressed = true;
-//        HandleButtonR();
-//    }
-//    else
+
+    if( events & (InputManager::eButtonL | InputManager::eButtonP | InputManager::eButtonR) )
     {
-//        if( enableButtons )
-//            wasButtonPressed = false;
-        if( M5.TP.avaliable() )
+        M5.update();
+        if( enableButtons && M5.BtnL.wasPressed() ) {
+            log_i("BtnL");
+            lastActive = millis();
+            Input.MarkActionStart();
+            HandleButtonL();
+        }
+        else if( enableButtons && M5.BtnP.wasPressed() ) {
+            log_i("BtnP");
+            lastActive = millis();
+            Input.MarkActionStart();
+            HandleButtonP();
+        }
+        else if( enableButtons && M5.BtnR.wasPressed() ) {
+            log_i("BtnR");
+            lastActive = millis();
+            Input.MarkActionStart();
+            HandleButtonR();
+        }
+    }
+
+    if( events & InputManager::eTouch )
+    {
+        M5.TP.update();
+        if( !M5.TP.isFingerUp() )
         {
-            if( !M5.TP.isFingerUp() )
+            Point<uint16_t> f1 = {M5.TP.readFingerX(0), M5.TP.readFingerY(0)};
+//            Point<uint16_t> f2 = {M5.TP.readFingerX(1), M5.TP.readFingerY(1)};
+            auto numFingers = M5.TP.getFingerNum();
+            M5.TP.flush();
+            // Get spurious touches at startup
+            if( f1 != Point<uint16_t>(0,0) && !wasFingerDown )
             {
-                M5.TP.update();
-                Point<uint16_t> f1 = {M5.TP.readFingerX(0), M5.TP.readFingerY(0)};
-//                Point<uint16_t> f2 = {M5.TP.readFingerX(1), M5.TP.readFingerY(1)};
-                auto numFingers = M5.TP.getFingerNum();
-    //            delay(100);
-                M5.TP.flush();
-                // Get spurious touches at startup
-                if( f1 != Point<uint16_t>(0,0) && !wasFingerDown )
+                wasFingerDown = true;
+                lastActive = millis();
+                Input.MarkActionStart();
+                switch( numFingers )
                 {
-                    wasFingerDown = true;
-                    lastActive = millis();
-                    switch( numFingers )
-                    {
-                        case 2:
-                //          HandleDoubleFinger( f1.first, f1.second, f2.first, f2.second );
-                        break;
-                        case 1:
-                            HandleSingleFinger( f1 );
-                        break;
-                    }
-                    delay(200);
+                    case 2:
+            //          HandleDoubleFinger( f1.first, f1.second, f2.first, f2.second );
+                    break;
+                    case 1:
+                        HandleSingleFinger( f1 );
+                    break;
                 }
-            } else
-                wasFingerDown = false;
+            }
         } else
             wasFingerDown = false;
     }
+}
 
-    if( DesiredUpdateMode != UPDATE_MODE_NONE )
-    {
-//        log_i("Delayed update");
-        M5.EPD.WritePartGram4bpp(CanvasPos.x, CanvasPos.y, CanvasSize.cx, CanvasSize.cy, (uint8_t*)Canvas.frameBuffer());
-        if( !PopupDialogActive )
-        {
-//            log_i("Delayed update - no popup");
-            M5.EPD.UpdateArea(CanvasPos.x, CanvasPos.y, CanvasSize.cx, CanvasSize.cy, DesiredUpdateMode);
-            DesiredUpdateMode = UPDATE_MODE_NONE;
-        }
-    }
-    if( this != &BaseDisplayManager && BaseDisplayManager.DesiredUpdateMode != UPDATE_MODE_NONE )
-    {
-//        log_i("Delayed update - not base");
-        M5.EPD.WritePartGram4bpp(BaseDisplayManager.CanvasPos.x, BaseDisplayManager.CanvasPos.y, BaseDisplayManager.CanvasSize.cx, BaseDisplayManager.CanvasSize.cy, (uint8_t*)BaseDisplayManager.Canvas.frameBuffer());
-        M5.EPD.WritePartGram4bpp(CanvasPos.x, CanvasPos.y, CanvasSize.cx, CanvasSize.cy, (uint8_t*)Canvas.frameBuffer());
-        Rect<uint16_t> updateRect = Rect<uint16_t>{CanvasPos,CanvasSize}.outersect(BaseDisplayManager.DesiredUpdateRect);        
-        M5.EPD.UpdateArea(updateRect.left, updateRect.top, updateRect.right, updateRect.bottom, BaseDisplayManager.DesiredUpdateMode);
-        BaseDisplayManager.DesiredUpdateMode = UPDATE_MODE_NONE;
-    }
+// Wheel up undoes, wheel down redoes
+void DisplayManager::HandleButtonL() { SudokuState before = CurrentState; ShowJournalMove(Journal.Undo(CurrentState), before); };
+void DisplayManager::HandleButtonP() { ShowDiagnostics(); };
+void DisplayManager::HandleButtonR() { SudokuState before = CurrentState; ShowJournalMove(Journal.Redo(CurrentState), before); };
+
+void DisplayManager::ShowJournalMove( Point<int8_t> square, const SudokuState& before )
+{
+    if( square.x < 0 )
+        return;
+    std::bitset<81> changed = CurrentState.ChangedSquares(before);
+    changed.set(CurrentSquare.y*9 + CurrentSquare.x);
+    CurrentSquare = Point<uint8_t>(square.x, square.y);
+    changed.set(CurrentSquare.y*9 + CurrentSquare.x);
+    LastValidation.clear();
+    if( !CurrentState.HasSolution() )
+        Validator.Request(CurrentState);
+    drawSquares(changed);
+}
+
+void DisplayManager::ShowValidation()
+{
+    uint8_t result;
+    if( !Validator.GetResult(CurrentState, result) )
+        return;
+    LastValidation = BackgroundValidator::Describe(result, CurrentState.Solved());
+    BaseDisplayManager.drawSquares(std::bitset<81>());
 }
 
-void DisplayManager::HandleButtonL() { };
-void DisplayManager::HandleButtonP() { };
-void DisplayManager::HandleButtonR() { };
 void DisplayManager::HandleSingleFinger( const Point<uint16_t>& hitIn )
 {
     Point<uint16_t> hit = hitIn - CanvasPos;
 //    log_d("Converted hit from (%d,%d) to (%d,%d), canvas pos (%d,%d)"
 //        , hitIn.x, hitIn.y, hit.x, hit.y, CanvasPos.x, CanvasPos.y );
-    for( auto& item : LayoutItems )
-        if( item->hitTest(hit) )
-            break;
+    const LayoutTable::Entry* entry = LayoutItems->hitTest(hit);
+    if( entry )
+    {
+        log_d("Hit");
+        PERF_HEAP_CHECK();
+        entry->Action->doAction();
+    }
 }
 
 /*
 
 */
 
+// A random puzzle of the band from the collection on the SD card, if there is one
+static bool DrawFromCollection( SudokuState& state, const DifficultyBand& band, DifficultyRater<3>& rater )
+{
+    if( !Collection.IsOpen() )
+        return false;
+    for( uint8_t tries = 0 ; tries < 20 ; tries++ )
+    {
+        if( !Collection.Load(g_() % Collection.GetCount(), state) )
+            continue;
+        SudokuState check = state;
+        if( check.SolveUniquely() != 1 )
+            continue;
+        Rating rating = rater.Rate(state);
+        if( band.Contains(rating) )
+        {
+            TextBuffer text;
+            log_d("From the collection: %s", rating.Describe(text));
+            return true;
+        }
+    }
+    return false;
+}
+
+// The old game stays in its slot
+static void StartGame( const SudokuState& state )
+{
+    if( Saves.GetInfo(Saves.GetCurrent()).InUse() )
+        CurrentState.Save();
+    Journal.Clear();
+    CurrentState = state;
+    LastValidation.clear();
+    // Snapshot straight away so the journal has something to build on
+    Saves.StartNew(CurrentState);
+    BaseDisplayManager.draw();
+}
+
 void DisplayManager::ShowNewGameDialog()
 {
-    DisplayManager newGameDlg;
+    // After deep sleep the collection is only looked for once a new game is wanted
+    Collection.Begin();
+
+    // Kept between uses so its layout is only built once
+    static DisplayManager newGameDlg;
     newGameDlg.Rotation = Rotation;
     newGameDlg.SetLayout(eLayout::eNewGame);
+    newGameDlg.ShowLayer();
 
     newGameDlg.redraw();
     newGameDlg.ShouldClose = false;
+    newGameDlg.Cancelled = false;
 
-    PopupDialogActive = true;
     while( !newGameDlg.ShouldClose )
     {
         newGameDlg.doLoop(false);
-        delay(100);
 //        yield();
     }
 
-    newGameDlg.clearScreen();
     if( !newGameDlg.Cancelled )
     {
-        newGameDlg.drawString(&FreeSans24pt7b,CC_DATUM,"Please wait...",Rect<uint16_t>(Point<uint16_t>(0,0),newGameDlg.CanvasSize));
-        newGameDlg.Canvas.pushCanvas(newGameDlg.CanvasPos.x,newGameDlg.CanvasPos.y,UPDATE_MODE_DU);
+        {
+            DisplayLock lock;
+            newGameDlg.clearScreen();
+            newGameDlg.drawString(&FreeSans24pt7b,CC_DATUM,"Please wait...",Rect<uint16_t>(Point<uint16_t>(0,0),newGameDlg.CanvasSize));
+        }
+        newGameDlg.refreshScreen(UPDATE_MODE_DU);
 
         SudokuState temp;
-        temp.GenerateRandom(TargetFixedCells,TargetSolveTimeMS);
-        CurrentState = temp;
-        LastValidation = "";
-        SudokuState::RemoveSave();
+        static DifficultyRater<3> rater;
+        Scratch.Reset();
+        // Another go if it is one of the saved games over again
+        for( uint8_t tries = 0 ; tries < 3 ; tries++ )
+        {
+            if( TargetFixedCells )
+            {
+                temp.GenerateRandom(TargetFixedCells,TargetSolveTimeMS);
+                TextBuffer text;
+                log_d("Rating: %s", rater.Rate(temp).Describe(text));
+            }
+            else if( !InstantGames || !(DrawFromCollection(temp, DifficultyBand::Get(TargetLevel), rater) || SeedBank::Draw(temp, TargetLevel)) )
+                rater.Generate(temp, DifficultyBand::Get(TargetLevel));
+            if( !Saves.HasPuzzle(temp.CanonicalHash()) )
+                break;
+            log_d("Same as a saved game");
+        }
+        log_d("Scratch high water %u of %u bytes", (uint32_t)Scratch.GetHighWater(), (uint32_t)Scratch.GetSize());
+        // A puzzle made without enough scratch may not be unique, a seed needs far less
+        bool ok = true;
+        if( Scratch.HasOverflowed() )
+        {
+            log_d("Out of scratch, drawing from the seed bank");
+            Scratch.Reset();
+            ok = SeedBank::Draw(temp, TargetLevel) && !Scratch.HasOverflowed();
+        }
+        if( ok )
+            StartGame(temp);
     }
 
-    Canvas.pushCanvas(CanvasPos.x,CanvasPos.y,UPDATE_MODE_GC16);
-    PopupDialogActive = false;
+    newGameDlg.HideLayer();
+    newGameDlg.ReleaseCanvas();
+}
+
+void DisplayManager::ShowLoadGameDialog()
+{
+    static DisplayManager loadGameDlg;
+    loadGameDlg.Rotation = Rotation;
+    loadGameDlg.SetLayout(eLayout::eLoadGame);
+    loadGameDlg.ShowLayer();
+
+    loadGameDlg.redraw();
+    loadGameDlg.ShouldClose = false;
+    loadGameDlg.Cancelled = false;
+
+    while( !loadGameDlg.ShouldClose )
+        loadGameDlg.doLoop(false);
+
+    if( !loadGameDlg.Cancelled )
+    {
+        // Picking the current game goes back to its last save
+        if( loadGameDlg.SelectedSlot != Saves.GetCurrent() )
+            CurrentState.Save();
+        Journal.Clear();
+        SudokuState temp;
+        if( Saves.Load(temp, loadGameDlg.SelectedSlot) )
+            CurrentState = temp;
+        LastValidation.clear();
+    }
+
+    loadGameDlg.HideLayer();
+    loadGameDlg.ReleaseCanvas();
+    if( !loadGameDlg.Cancelled )
+        BaseDisplayManager.draw(true);
+}
+
+bool DisplayManager::ShowCollectionDialog()
+{
+    static DisplayManager collectionDlg;
+    collectionDlg.Rotation = Rotation;
+    collectionDlg.SetLayout(eLayout::eCollection);
+    collectionDlg.ShowLayer();
+
+    collectionDlg.redraw();
+    collectionDlg.ShouldClose = false;
+    collectionDlg.Cancelled = false;
+
+    while( !collectionDlg.ShouldClose )
+        collectionDlg.doLoop(false);
+
+    SudokuState temp;
+    bool started = !collectionDlg.Cancelled && Collection.Load(CollectionNumber, temp);
+    if( started )
+        StartGame(temp);
+
+    collectionDlg.HideLayer();
+    collectionDlg.ReleaseCanvas();
+    return started;
+}
+
+void DisplayManager::ShowDiagnostics()
+{
+    static DisplayManager diagnosticsDlg;
+    diagnosticsDlg.Rotation = Rotation;
+    diagnosticsDlg.SetLayout(eLayout::eDiagnostics);
+    diagnosticsDlg.ShowLayer();
+
+    diagnosticsDlg.redraw();
+    diagnosticsDlg.ShouldClose = false;
+
+    while( !diagnosticsDlg.ShouldClose )
+        diagnosticsDlg.doLoop(false);
 
-    BaseDisplayManager.draw(true);
+    diagnosticsDlg.HideLayer();
+    diagnosticsDlg.ReleaseCanvas();
 }
 
 void DisplayManager::doShutdownIfOnBattery()
@@ -599,37 +1310,66 @@ void DisplayManager::doShutdownIfOnBattery()
     // Cannot tell for sure, guess
     uint32_t bv = M5.getBatteryVoltage();
     log_d("Battery voltage %d vs target of 4200",bv);
-    if( bv < 4200 )
+    if( bv >= 4200 )
+        showBatteryVoltage(bv);
+    else if( !Power.IsBatteryCritical(bv) )
+        BaseDisplayManager.doDeepSleep();
+    else
+    {
+        showBatteryVoltage(bv);
         doShutdown();
+    }
 }
 
-void DisplayManager::doShutdown()
+void DisplayManager::showBatteryVoltage( uint32_t batteryMV )
 {
+    Rect<uint16_t> voltRect(CanvasSize.cx-60,0,CanvasSize.cx,60);
+    // As volts to two places
+    uint32_t centiVolts = (batteryMV + 5) / 10;
+    TextBuffer text;
+    text << centiVolts / 100 << '.' << (centiVolts % 100 < 10 ? "0" : "") << centiVolts % 100;
+    {
+        DisplayLock lock;
+        fillRect(voltRect,0);
+        drawString(&FreeSans9pt7b,BL_DATUM,text.c_str(), voltRect);
+    }
+    invalidate(voltRect,UPDATE_MODE_GC16);
+    flush();
+}
+
+void DisplayManager::doDeepSleep()
+{
+    // NVS stays the fallback in case the battery runs out while asleep
     CurrentState.Save();
 
-    Point<uint16_t> windowPoint;
-    if( Rotation % 180 == 0 )
-        windowPoint = {280,70};
+    WaitForDisplayIdle();
+    M5.EPD.CheckAFSR();
+    Power.DeepSleep(CurrentState, CurrentSquare, LastValidation, CurrentLayout, Rotation, canvasCrc());
+}
+
+// Restores the screen after deep sleep, only touching the panel if it would not show the same thing
+void DisplayManager::drawAfterSleep()
+{
+    render();
+    if( canvasCrc() == Power.GetCanvasCrc() )
+        log_d("Canvas unchanged over sleep");
     else
-        windowPoint = {70,280};
-    Rect<uint16_t> windowRect = {windowPoint,{400,400}};
+        refreshScreen(UPDATE_MODE_GC16);
+}
 
-    M5EPD_Canvas tempCanvas(&M5.EPD);
-    tempCanvas.createCanvas(windowRect.width(),windowRect.height());
+void DisplayManager::doShutdown()
+{
+    CurrentState.Save();
 
-    tempCanvas.fillRect(0,0,windowRect.width(),windowRect.height(),0);
-    tempCanvas.drawRect(0,0,windowRect.width(),windowRect.height(),15);
-    tempCanvas.drawRect(5,5,windowRect.width()-10,windowRect.height()-10,15);
+    static DisplayManager shutdownDlg;
+    shutdownDlg.Rotation = Rotation;
+    shutdownDlg.SetLayout(eLayout::eShutdown);
+    shutdownDlg.ShowLayer();
+    shutdownDlg.redraw();
 
-    tempCanvas.setTextDatum(TC_DATUM);
-    tempCanvas.setFreeFont(&FreeSansBold24pt7b);
-    tempCanvas.drawString("Shutdown",windowRect.width()/2,50);
-    tempCanvas.setFreeFont(&FreeSansBold18pt7b);
-    tempCanvas.drawString("Hold side button",windowRect.width()/2,200);
-    tempCanvas.drawString("to restart",windowRect.width()/2,240);
+    WaitForDisplayIdle();
+    M5.EPD.CheckAFSR();
 
-    tempCanvas.pushCanvas(windowPoint.x,windowPoint.y,UPDATE_MODE_GC16);
-    
     log_d("About to disable main power");
     delay(200);
     M5.disableMainPower();
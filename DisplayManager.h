@@ -2,12 +2,35 @@
 
 #include <list>
 #include <memory>
+#include <atomic>
+#include <bitset>
 
 #include <M5EPD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 
 #include "Utility.h"
+#include "LayoutTable.h"
 
 class LayoutItem;
+class SudokuState;
+struct DisplayManager;
+
+// A request for the display task to compose the layers over an area and push it to the panel
+struct DisplayUpdate
+{
+    Rect<uint16_t>          Area;               // In screen coordinates
+    m5epd_update_mode_t     Mode = UPDATE_MODE_NONE;
+};
+
+// Held while touching a canvas or the EPD from either the UI loop or the display task
+class DisplayLock
+{
+public:
+    DisplayLock();
+    ~DisplayLock();
+};
 
 struct DisplayManager
 {
@@ -17,50 +40,111 @@ struct DisplayManager
 
         eSingleSquare,
 
-        eNewGame
+        eNewGame,
+        eLoadGame,
+        eCollection,
+        eDiagnostics,
+        eShutdown,
+
+        eLayoutCount
     };
 
 protected:
-    M5EPD_Canvas Canvas;
+    // Everything SetLayout needs for one layout, built the first time that layout is used
+    struct CachedLayout
+    {
+        LayoutTable     Items;
+        Size<uint16_t>  CanvasSize;
+        Point<uint16_t> CanvasPos;
+        uint16_t        Rotation = 0;       // Before any 180 degree flip
+        bool            ClearScreen = true;
+        bool            Centred = false;    // CanvasPos is worked out from the screen size
+    };
+
+    M5EPD_Canvas*   Canvas = nullptr;       // Borrowed from Canvases
     Size<uint16_t>  CanvasSize;
     Point<uint16_t>  CanvasPos;
     uint16_t Rotation = 0;
     eLayout  CurrentLayout = eBoard_Landscape;
-    std::list<std::shared_ptr<LayoutItem>>    LayoutItems;
+    std::unique_ptr<CachedLayout>   Layouts[eLayoutCount];
+    LayoutTable*    LayoutItems = nullptr;
     bool ShouldClose = false;
     bool Cancelled = false;
-    bool PopupDialogActive = false;
-    Rect<uint16_t>   DesiredUpdateRect{0,0,0,0};
-    m5epd_update_mode_t     DesiredUpdateMode = UPDATE_MODE_NONE;
+    uint8_t SelectedSlot = 0;
+    Rect<uint16_t>          DirtyRect;
+    m5epd_update_mode_t     DirtyMode = UPDATE_MODE_NONE;
+    std::bitset<81>         ShownMistakes;
+
+    // Shown DisplayManagers, bottom first, composed together by the display task
+    static constexpr uint8_t        MaxLayers = 4;
+    static DisplayManager*          Layers[MaxLayers];
+    static uint8_t                  LayerCount;
+    static uint8_t*                 ComposeBuffer;
+
+    static QueueHandle_t            UpdateQueue;
+    static SemaphoreHandle_t        Mutex;
+    static std::atomic<uint32_t>    PendingUpdates;
+
+    static void DisplayTask( void* );
+    static void ProcessUpdate( const DisplayUpdate& update );
+    static void queueScreenUpdate( Rect<uint16_t> area, m5epd_update_mode_t updateMode );
+    Rect<uint16_t> screenRect() const { return Rect<uint16_t>(CanvasPos,CanvasSize); };
+    void BuildLayout( eLayout layout, CachedLayout& cached );
+    void ReleaseCanvas();
+
+    friend class DisplayLock;
 
 public:
     DisplayManager();
     void Init( bool appInit = false );
     void SetLayout( eLayout );
 
+    // Renders every item, then sends whatever has been invalidated since the last draw,
+    // or the whole layout if nothing has been
     void draw( bool bFullRedraw = false );
+    // Renders every item, but only sends the given board squares, any whose mistake marking
+    // has changed, and the items off the board
+    void drawSquares( std::bitset<81> squares );
     void redraw();
+    void render();      // Items into the canvas only
+    void drawAfterSleep();
+    uint32_t canvasCrc() const;
+
+    void ShowLayer();
+    void HideLayer( m5epd_update_mode_t mode = UPDATE_MODE_GC16 );
+    void invalidate( const Rect<uint16_t>& rect, m5epd_update_mode_t mode = UPDATE_MODE_DU4 );     // rect in canvas coordinates
+    void flush();
 
     M5EPD_Canvas&   GetCanvas();
     void drawRect( const Rect<uint16_t>& rect, uint32_t colour );
     void fillRect( const Rect<uint16_t>& rect, uint32_t colour );
-    void drawString( const GFXfont* font, uint8_t datum, String str, const Rect<uint16_t>& rect );
-    void drawString( const GFXfont* font, uint8_t datum, String str, uint32_t x, uint32_t y );
+    void drawString( const GFXfont* font, uint8_t datum, const char* str, const Rect<uint16_t>& rect );
+    void drawString( const GFXfont* font, uint8_t datum, const char* str, uint32_t x, uint32_t y );
     
     void clearScreen();
     void refreshScreen( m5epd_update_mode_t mode = UPDATE_MODE_GC16 );
-    void M5EPD_flushAndUpdateArea( const Rect<uint16_t>& rect, m5epd_update_mode_t updateMode );
+
+    static void StartDisplayTask();
+    static void WaitForDisplayIdle();
+    static bool IsDisplayIdle() { return PendingUpdates == 0; };
 
     void doLoop( bool enableButtons = true );
 
     void HandleButtonL();
     void HandleButtonP();
     void HandleButtonR();
+    void ShowJournalMove( Point<int8_t> square, const SudokuState& before );
     void HandleSingleFinger( const Point<uint16_t>& hit );
+    void ShowValidation();      // The background check result, if it is for the current board
 
     void ShowNewGameDialog();
+    void ShowLoadGameDialog();
+    bool ShowCollectionDialog();        // returns true if a puzzle from it was started
+    void ShowDiagnostics();
 
     void doShutdownIfOnBattery();
+    void showBatteryVoltage( uint32_t batteryMV );
+    void doDeepSleep();
     void doShutdown();
 };
 
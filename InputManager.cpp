@@ -0,0 +1,136 @@
+#include "InputManager.h"
+
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+
+#include "DisplayManager.h"
+
+InputManager Input;
+
+void IRAM_ATTR InputManager::OnTouchInterrupt() { Input.PostFromISR(eTouch); }
+void IRAM_ATTR InputManager::OnButtonLInterrupt() { Input.PostFromISR(eButtonL); }
+void IRAM_ATTR InputManager::OnButtonPInterrupt() { Input.PostFromISR(eButtonP); }
+void IRAM_ATTR InputManager::OnButtonRInterrupt() { Input.PostFromISR(eButtonR); }
+
+void IRAM_ATTR InputManager::PostFromISR( uint8_t events )
+{
+    portENTER_CRITICAL_ISR(&EventMux);
+    if( PendingEvents == eNone )
+        EventTimeUS = esp_timer_get_time();
+    PendingEvents |= events;
+    portEXIT_CRITICAL_ISR(&EventMux);
+
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(WakeSemaphore, &woken);
+    if( woken )
+        portYIELD_FROM_ISR();
+}
+
+void InputManager::Post( uint8_t events, int64_t timeUS )
+{
+    portENTER_CRITICAL(&EventMux);
+    if( PendingEvents == eNone )
+        EventTimeUS = timeUS;
+    PendingEvents |= events;
+    portEXIT_CRITICAL(&EventMux);
+}
+
+void InputManager::Init()
+{
+    WakeSemaphore = xSemaphoreCreateBinary();
+
+    // Replaces the GT911 driver's own flag-setting handler, DisplayManager reads the panel on eTouch instead
+    pinMode(TouchPin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(TouchPin), OnTouchInterrupt, FALLING);
+    // Releases too, M5.update() has to see a button go up before it will report the next press
+    pinMode(M5EPD_KEY_LEFT_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(M5EPD_KEY_LEFT_PIN), OnButtonLInterrupt, CHANGE);
+    pinMode(M5EPD_KEY_PUSH_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(M5EPD_KEY_PUSH_PIN), OnButtonPInterrupt, CHANGE);
+    pinMode(M5EPD_KEY_RIGHT_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(M5EPD_KEY_RIGHT_PIN), OnButtonRInterrupt, CHANGE);
+
+    ArmWakePins(eNone);
+    esp_sleep_enable_gpio_wakeup();
+}
+
+// All of these idle high and are pulled low when active. Level wakeups keep firing for as long as the
+// level holds, so a pin that is already low, such as a held button, wakes when it goes high again instead.
+void InputManager::ArmWakePins( uint8_t low )
+{
+    gpio_wakeup_enable((gpio_num_t)TouchPin, low & eTouch ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    gpio_wakeup_enable((gpio_num_t)M5EPD_KEY_LEFT_PIN, low & eButtonL ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    gpio_wakeup_enable((gpio_num_t)M5EPD_KEY_PUSH_PIN, low & eButtonP ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    gpio_wakeup_enable((gpio_num_t)M5EPD_KEY_RIGHT_PIN, low & eButtonR ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+}
+
+bool InputManager::CanSleep() const
+{
+    return LightSleepEnabled && SleepInhibitors == 0 && DisplayManager::IsDisplayIdle();
+}
+
+uint8_t InputManager::ReadWakePins() const
+{
+    uint8_t events = eNone;
+    if( digitalRead(TouchPin) == LOW )
+        events |= eTouch;
+    if( digitalRead(M5EPD_KEY_LEFT_PIN) == LOW )
+        events |= eButtonL;
+    if( digitalRead(M5EPD_KEY_PUSH_PIN) == LOW )
+        events |= eButtonP;
+    if( digitalRead(M5EPD_KEY_RIGHT_PIN) == LOW )
+        events |= eButtonR;
+    return events;
+}
+
+uint8_t InputManager::WaitForEvent( uint32_t timeoutMS )
+{
+    auto start = millis();
+    while( PendingEvents == eNone && millis() - start < timeoutMS )
+    {
+        uint32_t remainingMS = timeoutMS - (millis() - start);
+        if( CanSleep() )
+        {
+            uint8_t low = ReadWakePins();
+            ArmWakePins(low);
+            esp_sleep_enable_timer_wakeup((uint64_t)remainingMS * 1000);
+            esp_light_sleep_start();
+            // Edge interrupts are not serviced while asleep, so work out what woke us from the pin levels
+            if( esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO )
+            {
+                uint8_t events = ReadWakePins() ^ low;
+                // The touch pulse can be over by the time the pins are read
+                Post(events != eNone ? events : (uint8_t)eTouch, esp_timer_get_time());
+            }
+        }
+        else
+            // Something is still running, wake periodically to see if sleep is now possible
+            xSemaphoreTake(WakeSemaphore, pdMS_TO_TICKS(min<uint32_t>(remainingMS,20)));
+    }
+
+    portENTER_CRITICAL(&EventMux);
+    uint8_t events = PendingEvents;
+    PendingEvents = eNone;
+    HandledEventTimeUS = EventTimeUS;
+    portEXIT_CRITICAL(&EventMux);
+    return events;
+}
+
+void InputManager::MarkActionStart()
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t latency = now - HandledEventTimeUS;
+    Latency.Count++;
+    Latency.LastUS = latency;
+    Latency.MaxUS = max(Latency.MaxUS, latency);
+    Latency.TotalUS += latency;
+    log_d("Input latency %dus (max %dus, mean %dus over %d)", Latency.LastUS, Latency.MaxUS, (uint32_t)(Latency.TotalUS / Latency.Count), Latency.Count);
+}
+
+void InputManager::Wake()
+{
+    Post(eWake, esp_timer_get_time());
+    if( WakeSemaphore )
+        xSemaphoreGive(WakeSemaphore);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+
+#include <M5EPD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Turns the GT911 touch interrupt and the side buttons into events for the UI loop,
+// light sleeping the ESP32 while there is nothing to do
+class InputManager
+{
+public:
+    enum eEvent : uint8_t {
+        eNone       = 0,
+        eTouch      = 1 << 0,
+        eButtonL    = 1 << 1,
+        eButtonP    = 1 << 2,
+        eButtonR    = 1 << 3,
+        eWake       = 1 << 4,   // Posted by Wake(), no input
+    };
+
+    struct LatencyStats
+    {
+        uint32_t    Count = 0;
+        uint32_t    LastUS = 0;
+        uint32_t    MaxUS = 0;
+        uint64_t    TotalUS = 0;
+    };
+
+protected:
+    static constexpr uint8_t TouchPin = 36;
+
+    SemaphoreHandle_t       WakeSemaphore = nullptr;
+    portMUX_TYPE            EventMux = portMUX_INITIALIZER_UNLOCKED;
+    volatile uint8_t        PendingEvents = eNone;
+    volatile int64_t        EventTimeUS = 0;        // Time of the first unhandled interrupt
+    int64_t                 HandledEventTimeUS = 0; // Time of the interrupt behind the events last returned
+    std::atomic<uint32_t>   SleepInhibitors{0};
+    LatencyStats            Latency;
+
+    static void IRAM_ATTR   OnTouchInterrupt();
+    static void IRAM_ATTR   OnButtonLInterrupt();
+    static void IRAM_ATTR   OnButtonPInterrupt();
+    static void IRAM_ATTR   OnButtonRInterrupt();
+    void IRAM_ATTR          PostFromISR( uint8_t events );
+    void                    Post( uint8_t events, int64_t timeUS );
+
+    bool    CanSleep() const;
+    uint8_t ReadWakePins() const;           // eEvent bits of the pins that are low
+    void    ArmWakePins( uint8_t low );
+
+public:
+    bool    LightSleepEnabled = true;
+
+    void    Init();
+
+    // Blocks (light sleeping if possible) until an input event or the timeout, returns the eEvent bits
+    uint8_t WaitForEvent( uint32_t timeoutMS );
+
+    // Call when the action for the current event starts, records interrupt to action latency
+    void    MarkActionStart();
+    const LatencyStats& GetLatency() const { return Latency; };
+
+    // Keep the CPU awake while background work is in progress
+    void    InhibitSleep() { SleepInhibitors++; };
+    void    AllowSleep() { SleepInhibitors--; };
+    // Makes WaitForEvent return eWake, call before AllowSleep() or the UI can light sleep first
+    void    Wake();
+};
+
+extern InputManager Input;
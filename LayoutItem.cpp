@@ -6,14 +6,19 @@
 
 #include "SudokuState.h"
 #include "SudokuSquare.h"
+#include "MoveJournal.h"
+#include "Validator.h"
 
 extern SudokuState CurrentState;
 extern Point<uint8_t> CurrentSquare;
 
-extern String LastValidation;
+extern TextBuffer LastValidation;
+extern bool AutoCandidates;
 
 bool drawIcon( M5EPD_Canvas& canvas, const unsigned char* bmpFS, size_t size, uint16_t x, uint16_t y );
 
+static const char* const Digits[] = { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9" };
+
 LayoutItem::LayoutItem( Rect<uint16_t> rect, tdAction action )
 : Location(rect)
 , Action(action)
@@ -27,25 +32,7 @@ LayoutItemWithFont::LayoutItemWithFont( Rect<uint16_t> rect, const GFXfont* font
 {
 }
 
-bool LayoutItem::hitTest( const Point<uint16_t>& hit )
-{
-    if( Action.get() && Action->hasAction() )
-    {
-//        log_d("Possible hit, testing location (%d,%d) vs (%d,%d,%d,%d)"
-//            , hit.x, hit.y
-//            , Location.left,Location.top,Location.right,Location.bottom );
-        if( Location.contains(hit) )
-        {
-            log_d("Hit");
-            Action->doAction();
-            return true;
-        }
-    } 
-
-    return false;
-}
-
-void LayoutItemWithFont::drawString( DisplayManager& displayManager, String str )
+void LayoutItemWithFont::drawString( DisplayManager& displayManager, const char* str )
 {
     displayManager.fillRect(Location,0);
     displayManager.drawString( Font, TextAlign, str, Location);
@@ -83,7 +70,7 @@ void LayoutItem_ButtonIconWithHighlight::draw( DisplayManager& displayManager )
     }
 }
 
-LayoutItem_StaticText::LayoutItem_StaticText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, String text, tdAction action )
+LayoutItem_StaticText::LayoutItem_StaticText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, const char* text, tdAction action )
 : LayoutItemWithFont(rect,font,align,action)
 , Text(text)
 {
@@ -99,19 +86,23 @@ void LayoutItem_StaticText::draw( DisplayManager& displayManager )
     drawString( displayManager, Text);
 }
 
-LayoutItem_DynamicText::LayoutItem_DynamicText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, tdStringFunc func, tdOutlineFunc outlineFunc, tdAction action )
-: LayoutItemWithFont(rect,font,align,action)
+LayoutItem_DynamicText::LayoutItem_DynamicText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, tdStringFunc func, tdOutlineFunc outlineFunc, LayoutItemAction_Function::tdFunc actionFunc )
+: LayoutItemWithFont(rect,font,align,actionFunc ? &ActionFunc : nullptr)
 , TextFunc(func)
 , OutlineFunc(outlineFunc)
+, ActionFunc(actionFunc)
 {
-
 }
 
 void LayoutItem_DynamicText::draw( DisplayManager& displayManager )
 {
     displayManager.fillRect(Location, 0);
     if( TextFunc )
-        drawString( displayManager, TextFunc() );
+    {
+        TextBuffer text;
+        TextFunc(text);
+        drawString( displayManager, text.c_str() );
+    }
     if( OutlineFunc && OutlineFunc() )
         displayManager.drawRect(Location, 15);
 }
@@ -123,26 +114,36 @@ LayoutItemAction_SudokuSquare::LayoutItemAction_SudokuSquare( uint8_t x, uint8_t
 
 void LayoutItemAction_SudokuSquare::doAction()
 {
+    std::bitset<81> changed;
+    changed.set(CurrentSquare.y*9 + CurrentSquare.x);
+    changed.set(WhichSquare.y*9 + WhichSquare.x);
     CurrentSquare = WhichSquare;
-    BaseDisplayManager.draw();
+    BaseDisplayManager.drawSquares(changed);
 }
 
 LayoutItem_SudokuSquare::LayoutItem_SudokuSquare( Rect<uint16_t> rect, uint8_t x, uint8_t y )
-: LayoutItem(rect,std::make_shared<LayoutItemAction_SudokuSquare>(x,y))
+: LayoutItem(rect,&SquareAction)
 , WhichSquare(x,y)
+, SquareAction(x,y)
 {
 }
 
 void LayoutItem_SudokuSquare::draw( DisplayManager& displayManager )
 {
     SudokuSquare& mySquare = CurrentState.GetSquare(WhichSquare);
+    bool mistake = CurrentState.IsMistake(WhichSquare.x,WhichSquare.y);
     if( WhichSquare == CurrentSquare )
     {
         displayManager.fillRect(Location,15); 
+        if( mistake )
+            for( uint8_t i = 3 ; i < 7 ; i++ )
+                displayManager.drawRect(Rect<uint16_t>(Location.left+i,Location.top+i,Location.right-i,Location.bottom-i),5);
         displayManager.GetCanvas().setTextColor(0);
     }
+    else if( mistake )
+        displayManager.fillRect(Location,5);
     if( mySquare.Fixed() )
-        displayManager.drawString(&FreeSans24pt7b,CC_DATUM,String(mySquare.FirstPossible()),Location);
+        displayManager.drawString(&FreeSans24pt7b,CC_DATUM,Digits[mySquare.FirstPossible()],Location);
     else if( mySquare.Count() == 9 )
         ;
     else
@@ -152,7 +153,7 @@ void LayoutItem_SudokuSquare::draw( DisplayManager& displayManager )
         for( uint8_t x = 0 ; x < 3 ; x++ )
             for( uint8_t y = 0 ; y < 3 ; y++ )
                 if( mySquare.Possible(y*3+x+1) )
-                    displayManager.drawString(&FreeSans9pt7b,CC_DATUM,String(y*3+x+1)
+                    displayManager.drawString(&FreeSans9pt7b,CC_DATUM,Digits[y*3+x+1]
                     ,Rect<uint16_t>(Location.left+x*width,Location.top+y*height,Location.left+(x+1)*width,Location.top+(y+1)*height));
     }
     if( WhichSquare == CurrentSquare )
@@ -166,33 +167,45 @@ LayoutItemAction_SudokuSubSquare::LayoutItemAction_SudokuSubSquare( uint8_t val
 
 void LayoutItemAction_SudokuSubSquare::doAction()
 {
+    SudokuSquare before = CurrentState.GetSquare(CurrentSquare);
     if( CurrentState.GetSquare(CurrentSquare).Count() == 9 )
     {
-        CurrentState.GetSquare(CurrentSquare).SetSolution(WhichValue);
+        Journal.Record(CurrentState, CurrentSquare, JournalEntry::eSet, WhichValue);
     }
     else if( CurrentState.GetSquare(CurrentSquare).Possible(WhichValue) )
-        CurrentState.GetSquare(CurrentSquare).RemovePossible(WhichValue);
+        Journal.Record(CurrentState, CurrentSquare, JournalEntry::eRemove, WhichValue);
     else
-        CurrentState.GetSquare(CurrentSquare).AddPossible(WhichValue);
-    LastValidation = "";
-    BaseDisplayManager.draw();
+        Journal.Record(CurrentState, CurrentSquare, JournalEntry::eAdd, WhichValue);
+    std::bitset<81> changed;
+    changed.set(CurrentSquare.y*9 + CurrentSquare.x);
+    if( AutoCandidates )
+    {
+        SudokuState beforePeers = CurrentState;
+        changed |= CurrentState.UpdatePeerCandidates(CurrentSquare.x, CurrentSquare.y, before);
+        Journal.RecordDiff(CurrentState, beforePeers, true);
+    }
+    // Only once the peers are updated, or the validator checks a board that is never shown
+    LastValidation.clear();
+    if( !CurrentState.HasSolution() )
+        Validator.Request(CurrentState);
+    BaseDisplayManager.drawSquares(changed);
 }
 
 LayoutItem_SudokuSubSquare::LayoutItem_SudokuSubSquare( Rect<uint16_t> rect, uint8_t val )
-: LayoutItem(rect,std::make_shared<LayoutItemAction_SudokuSubSquare>(val))
+: LayoutItem(rect,&ValueAction)
 , WhichValue(val)
+, ValueAction(val)
 {
 }
 
 void LayoutItem_SudokuSubSquare::draw( DisplayManager& displayManager )
 {
-    log_d("Drawing %d at (%d,%d,%d,%d)",WhichValue,Location.left,Location.top,Location.right,Location.bottom);
     SudokuSquare& mySquare = CurrentState.GetSquare(CurrentSquare);
     displayManager.fillRect(Location,0);
     if( CurrentState.GetSquare(CurrentSquare).Count() == 9 )
         ;
     else if( mySquare.Possible(WhichValue) )
-        displayManager.drawString(&FreeSans24pt7b,CC_DATUM,String(WhichValue),Location);
+        displayManager.drawString(&FreeSans24pt7b,CC_DATUM,Digits[WhichValue],Location);
     else
         ;
 }
@@ -1,8 +1,6 @@
 #pragma once
 
-#include <memory>
 #include <list>
-#include <functional>
 
 #include <M5EPD.h>
 
@@ -26,12 +24,13 @@ public:
     virtual void    doAction() {};
 };
 
-class LayoutItemAction_StdFunction : public LayoutItemAction
+class LayoutItemAction_Function : public LayoutItemAction
 {
 public:
-    LayoutItemAction_StdFunction( std::function<void(void)> func ) : Func(func) {};
+    using tdFunc = InlineFunction<void(void)>;
+    LayoutItemAction_Function( tdFunc func = nullptr ) : Func(func) {};
 
-    std::function<void(void)>   Func;
+    tdFunc      Func;
 
     virtual bool    hasAction() { return !!Func; };
     virtual void    doAction() { Func(); };
@@ -40,7 +39,7 @@ public:
 class LayoutItem
 {
 public:
-    using tdAction = std::shared_ptr<LayoutItemAction>;
+    using tdAction = LayoutItemAction*;     // Not owned, items with actions hold their own
     LayoutItem( Rect<uint16_t> rect, tdAction action = nullptr );
     virtual ~LayoutItem() = default;
 
@@ -48,21 +47,19 @@ public:
     tdAction    Action;
 
     virtual void draw( DisplayManager& ) = 0;
-    virtual bool hitTest( const Point<uint16_t>& );
+    virtual int8_t boardSquare() const { return -1; };     // Cell y*9+x shown by the item, if any
 };
 
 class LayoutItemWithFont : public LayoutItem
 {
 public:
-    using tdAction = std::shared_ptr<LayoutItemAction>;
-
     LayoutItemWithFont( Rect<uint16_t> rect, const GFXfont* font = nullptr, uint8_t align = TL_DATUM, tdAction action = nullptr );
     virtual ~LayoutItemWithFont() = default;
 
     const GFXfont*  Font = nullptr;
     uint8_t  TextAlign = TL_DATUM;
 
-    virtual void drawString( DisplayManager&, String str );
+    virtual void drawString( DisplayManager&, const char* str );
 };
 
 class LayoutItem_ButtonIcon : public LayoutItem
@@ -78,7 +75,7 @@ public:
 class LayoutItem_ButtonIconWithHighlight : public LayoutItem_ButtonIcon
 {
 public:
-    using tdHighlightFunc = std::function<bool(void)>;
+    using tdHighlightFunc = InlineFunction<bool(void)>;
     LayoutItem_ButtonIconWithHighlight( Rect<uint16_t> rect, const unsigned char* data, size_t size, tdHighlightFunc func = nullptr, tdAction action = nullptr );
 
     tdHighlightFunc HighlightFunc;
@@ -94,21 +91,22 @@ class LayoutItem_Rectangle : public LayoutItem
 class LayoutItem_StaticText : public LayoutItemWithFont
 {
 public:
-    LayoutItem_StaticText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, String text, tdAction action = nullptr );
+    LayoutItem_StaticText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, const char* text, tdAction action = nullptr );
 
-    String  Text;
+    const char* Text;
     virtual void draw( DisplayManager& ) override;
 };
 
 class LayoutItem_DynamicText : public LayoutItemWithFont
 {
 public:
-    using tdStringFunc = std::function<String(void)>;
-    using tdOutlineFunc = std::function<bool(void)>;
-    LayoutItem_DynamicText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, tdStringFunc textFunc, tdOutlineFunc outlineFunc = [](){return false;}, tdAction action = nullptr );
+    using tdStringFunc = InlineFunction<void(TextBuffer&)>;
+    using tdOutlineFunc = InlineFunction<bool(void)>;
+    LayoutItem_DynamicText( Rect<uint16_t> rect, const GFXfont* font, uint8_t align, tdStringFunc textFunc, tdOutlineFunc outlineFunc = nullptr, LayoutItemAction_Function::tdFunc actionFunc = nullptr );
 
     tdStringFunc    TextFunc;
     tdOutlineFunc   OutlineFunc;
+    LayoutItemAction_Function   ActionFunc;
     virtual void draw( DisplayManager& ) override;
 };
 
@@ -127,7 +125,9 @@ public:
     LayoutItem_SudokuSquare( Rect<uint16_t> rect, uint8_t x, uint8_t y );
 
     Point<uint8_t>  WhichSquare;
+    LayoutItemAction_SudokuSquare   SquareAction;
     virtual void draw( DisplayManager& ) override;
+    virtual int8_t boardSquare() const override { return WhichSquare.y*9 + WhichSquare.x; };
 };
 
 class LayoutItemAction_SudokuSubSquare : public LayoutItemAction
@@ -145,6 +145,7 @@ public:
     LayoutItem_SudokuSubSquare( Rect<uint16_t> rect, uint8_t val );
 
     uint8_t         WhichValue;
+    LayoutItemAction_SudokuSubSquare    ValueAction;
     virtual void draw( DisplayManager& ) override;
 };
 
@@ -0,0 +1,71 @@
+#include "LayoutTable.h"
+
+#include <functional>
+
+#include "LayoutItem.h"
+
+void LayoutTable::clear()
+{
+    Entries.clear();
+    CellStart.clear();
+    CellEntries.clear();
+    Items.clear();
+}
+
+void LayoutTable::build( const Size<uint16_t>& canvasSize )
+{
+    Entries.clear();
+    Entries.reserve(Items.size());
+    for( auto& item : Items )
+    {
+        Entry entry;
+        entry.Location = item->Location;
+        entry.Item = item.get();
+        if( item->Action && item->Action->hasAction() )
+            entry.Action = item->Action;
+        Entries.push_back(entry);
+    }
+
+    GridSize = {(uint16_t)((canvasSize.cx + CellSize - 1) / CellSize), (uint16_t)((canvasSize.cy + CellSize - 1) / CellSize)};
+    uint16_t cellCount = GridSize.cx * GridSize.cy;
+    CellStart.assign(cellCount + 1, 0);
+
+    // Two passes, first counting entries per cell, then filling them in
+    auto forEachCell = [this]( const Rect<uint16_t>& rect, std::function<void(uint16_t)> func )
+    {
+        uint16_t right = min<uint16_t>(rect.right / CellSize, GridSize.cx - 1);
+        uint16_t bottom = min<uint16_t>(rect.bottom / CellSize, GridSize.cy - 1);
+        for( uint16_t y = rect.top / CellSize ; y <= bottom ; y++ )
+            for( uint16_t x = rect.left / CellSize ; x <= right ; x++ )
+                func(y * GridSize.cx + x);
+    };
+    for( auto& entry : Entries )
+        if( entry.Action )
+            forEachCell(entry.Location, [this]( uint16_t cell ) { CellStart[cell+1]++; });
+    for( uint16_t cell = 0 ; cell < cellCount ; cell++ )
+        CellStart[cell+1] += CellStart[cell];
+
+    CellEntries.resize(CellStart[cellCount]);
+    std::vector<uint16_t> fill(CellStart.begin(), CellStart.end() - 1);
+    for( uint16_t i = 0 ; i < Entries.size() ; i++ )
+        if( Entries[i].Action )
+            forEachCell(Entries[i].Location, [&]( uint16_t cell ) { CellEntries[fill[cell]++] = i; });
+
+    log_d("Layout table has %d items, %d in hit grid of %dx%d", (int)Entries.size(), (int)CellEntries.size(), GridSize.cx, GridSize.cy);
+}
+
+const LayoutTable::Entry* LayoutTable::hitTest( const Point<uint16_t>& pt ) const
+{
+    uint16_t x = pt.x / CellSize;
+    uint16_t y = pt.y / CellSize;
+    if( x >= GridSize.cx || y >= GridSize.cy )
+        return nullptr;
+    uint16_t cell = y * GridSize.cx + x;
+    for( uint16_t i = CellStart[cell] ; i < CellStart[cell+1] ; i++ )
+    {
+        const Entry& entry = Entries[CellEntries[i]];
+        if( entry.Location.contains(pt) )
+            return &entry;
+    }
+    return nullptr;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Utility.h"
+
+class LayoutItem;
+class LayoutItemAction;
+
+// All the items of one layout, in draw order, held in a flat table
+// Touchable items are also bucketed into a uniform grid so that a hit only tests the few items under that cell
+class LayoutTable
+{
+public:
+    struct Entry
+    {
+        Rect<uint16_t>      Location;
+        LayoutItem*         Item = nullptr;
+        LayoutItemAction*   Action = nullptr;   // nullptr if the item does not respond to touches
+    };
+
+protected:
+    static constexpr uint16_t   CellSize = 32;
+
+    std::vector<std::unique_ptr<LayoutItem>>    Items;
+    std::vector<Entry>          Entries;
+
+    Size<uint16_t>              GridSize;       // In cells
+    std::vector<uint16_t>       CellStart;      // Start of each cell's run in CellEntries, plus one past the end
+    std::vector<uint16_t>       CellEntries;    // Indexes into Entries, in draw order within each cell
+
+public:
+    template<class T, class... Args> T& add( Args&&... args )
+    {
+        T* item = new T(std::forward<Args>(args)...);
+        Items.emplace_back(item);
+        return *item;
+    }
+
+    // Call once all items have been added, canvasSize bounds the hit test grid
+    void    build( const Size<uint16_t>& canvasSize );
+    void    clear();
+
+    const Entry*    hitTest( const Point<uint16_t>& pt ) const;
+
+    bool            empty() const { return Entries.empty(); };
+    const Entry*    begin() const { return Entries.data(); };
+    const Entry*    end() const { return Entries.data() + Entries.size(); };
+};
@@ -1,6 +1,11 @@
 #include "M5EPD.h"
 
 #include "DisplayManager.h"
+#include "InputManager.h"
+#include "MoveJournal.h"
+#include "PowerManager.h"
+#include "PuzzleCollection.h"
+#include "ScratchArena.h"
 
 #include "SudokuState.h"
 
@@ -8,13 +13,25 @@ M5EPD_Canvas Canvas(&M5.EPD);
 
 SudokuState CurrentState;
 Point<uint8_t>  CurrentSquare;
-String      LastValidation = "";
+TextBuffer  LastValidation;
 
 void myloop(void*);
 
 void setup() 
 {
+  bool resuming = Power.CheckResume();
+  // Before anything else has a chance to break up the heap
+  Scratch.Reserve();
   BaseDisplayManager.Init(true);
+  Input.Init();
+
+  if( resuming && Power.Restore(CurrentState, CurrentSquare, LastValidation) )
+  {
+    BaseDisplayManager.drawAfterSleep();
+    Power.ResumeComplete();
+    return;
+  }
+  Power.ResumeComplete();
 
 //CurrentState.GenerateFromString("53  7    6  195    98    6 8   6   34  8 3  17   2   6 6    28    419  5    8  79"); // Propagate only
 //CurrentState.GenerateFromString("4       7  2 8 53    75   9  587  626 392  8  9  65     7        6  72      917 3"); // Propagate only
@@ -35,12 +52,13 @@ void setup()
     log_d("Is Solved: %c", CurrentState.Solved()?'Y':'N');
   }*/
 
-  SudokuState::CheckHasSave();
-  log_d("HasSave: %c", SudokuState::HasSave()?'Y':'N');
-  if( SudokuState::HasSave() )
-    CurrentState.Load();
+  bool hasSave = CurrentState.Load();
+  log_d("HasSave: %c", hasSave?'Y':'N');
+  if( hasSave )
+    Journal.Restore(CurrentState);
 
   BaseDisplayManager.draw();
+  Collection.Begin();
 
 //  disableCore0WDT();
 //  disableCore1WDT();
@@ -0,0 +1,186 @@
+#include "MoveJournal.h"
+
+#include <algorithm>
+
+#include <Preferences.h>
+
+#include "SudokuState.h"
+
+extern Preferences preferences;
+extern const char* Preferences_App;
+
+MoveJournal Journal;
+
+// Shared by every save slot, which is why switching games clears the undo history
+static const char* ChunkKey( uint8_t chunk )
+{
+    static const char* const keys[] = { "J0", "J1", "J2", "J3" };     // One per chunk, up to MaxChunks
+    return keys[chunk];
+}
+
+void MoveJournal::Apply( SudokuState& state, JournalEntry entry, bool forward )
+{
+    if( entry.Cell() >= SudokuState::CellCount )
+        return;
+    SudokuSquare& square = state.GetSquare(entry.Cell()%SudokuState::N, entry.Cell()/SudokuState::N);
+    switch( entry.Op() )
+    {
+    case JournalEntry::eAdd:
+        if( forward )
+            square.AddPossible(entry.Digit());
+        else
+            square.RemovePossible(entry.Digit());
+        break;
+    case JournalEntry::eRemove:
+        if( forward )
+            square.RemovePossible(entry.Digit());
+        else
+            square.AddPossible(entry.Digit());
+        break;
+    case JournalEntry::eSet:
+        if( forward )
+            square.SetSolution(entry.Digit());
+        else
+            square = SudokuSquare();
+        break;
+    }
+}
+
+void MoveJournal::Append( JournalEntry entry )
+{
+    // Anything that could have been redone is lost once a new move is made
+    History.resize(Cursor);
+    if( History.size() >= MaxHistory )
+    {
+        uint16_t drop = MaxHistory / 4;
+        History.erase(History.begin(), History.begin() + drop);
+        // Only when snapshots keep failing does this reach the moves in NVS, and then Persist() is already due to take one
+        PersistedFrom = PersistedFrom > drop ? PersistedFrom - drop : 0;
+    }
+    History.push_back(entry);
+    Cursor = History.size();
+}
+
+void MoveJournal::Record( SudokuState& state, Point<uint8_t> square, JournalEntry::eOp op, uint8_t digit )
+{
+    JournalEntry entry(square.y*SudokuState::N + square.x, digit, op, false);
+    Apply(state, entry, true);
+    Append(entry);
+    Persist(state);
+}
+
+void MoveJournal::RecordDiff( SudokuState& state, const SudokuState& before, bool withPrevious )
+{
+    bool group = withPrevious && Cursor > 0;
+    bool recorded = false;
+    for( uint8_t y = 0 ; y < SudokuState::N ; y++ )
+        for( uint8_t x = 0 ; x < SudokuState::N ; x++ )
+        {
+            const SudokuSquare& from = before.GetSquare(x,y);
+            const SudokuSquare& to = state.GetSquare(x,y);
+            for( uint8_t i = 1 ; i <= SudokuState::N ; i++ )
+                if( from.Possible(i) != to.Possible(i) )
+                {
+                    Append(JournalEntry(y*SudokuState::N+x, i, to.Possible(i) ? JournalEntry::eAdd : JournalEntry::eRemove, group));
+                    group = true;
+                    recorded = true;
+                }
+        }
+    if( recorded )
+        Persist(state);
+}
+
+Point<int8_t> MoveJournal::Undo( SudokuState& state )
+{
+    if( !CanUndo() )
+        return {-1,-1};
+    JournalEntry entry;
+    do
+    {
+        entry = History[--Cursor];
+        Apply(state, entry, false);
+    } while( entry.Group() && Cursor > 0 );
+    Persist(state);
+    return {(int8_t)(entry.Cell()%SudokuState::N), (int8_t)(entry.Cell()/SudokuState::N)};
+}
+
+Point<int8_t> MoveJournal::Redo( SudokuState& state )
+{
+    if( !CanRedo() )
+        return {-1,-1};
+    JournalEntry entry = History[Cursor];
+    do
+    {
+        Apply(state, History[Cursor++], true);
+    } while( Cursor < History.size() && History[Cursor].Group() );
+    Persist(state);
+    return {(int8_t)(entry.Cell()%SudokuState::N), (int8_t)(entry.Cell()/SudokuState::N)};
+}
+
+void MoveJournal::Persist( SudokuState& state )
+{
+    // Undone past the snapshot, or out of room: take a new snapshot, which calls Compacted()
+    if( Cursor < PersistedFrom || Cursor - PersistedFrom > ChunkEntries * MaxChunks )
+    {
+        log_d("Compacting journal at entry %d, snapshot was at %d", Cursor, PersistedFrom);
+        state.Save();
+        return;
+    }
+    WriteChunks(Cursor - PersistedFrom);
+}
+
+// Only the chunks between the old and new end of the journal are rewritten, usually just one
+void MoveJournal::WriteChunks( uint16_t count )
+{
+    uint16_t low = std::min(count, PersistedCount);
+    uint16_t high = std::max(count, PersistedCount);
+    if( low == high )
+        return;
+
+    preferences.begin(Preferences_App);
+    for( uint8_t chunk = low / ChunkEntries ; chunk <= (high - 1) / ChunkEntries ; chunk++ )
+    {
+        uint16_t start = chunk * ChunkEntries;
+        uint16_t entries = count > start ? std::min<uint16_t>(count - start, ChunkEntries) : 0;
+        if( entries > 0 )
+            preferences.putBytes(ChunkKey(chunk), &History[PersistedFrom + start], entries * sizeof(JournalEntry));
+        else
+            preferences.remove(ChunkKey(chunk));
+    }
+    preferences.end();
+    PersistedCount = count;
+}
+
+void MoveJournal::Restore( SudokuState& state )
+{
+    History.clear();
+    preferences.begin(Preferences_App);
+    for( uint8_t chunk = 0 ; chunk < MaxChunks ; chunk++ )
+    {
+        JournalEntry entries[ChunkEntries];
+        size_t count = preferences.getBytes(ChunkKey(chunk), entries, sizeof(entries)) / sizeof(JournalEntry);
+        History.insert(History.end(), entries, entries + count);
+        if( count < ChunkEntries )
+            break;
+    }
+    preferences.end();
+
+    for( JournalEntry entry : History )
+        Apply(state, entry, true);
+    Cursor = PersistedCount = History.size();
+    PersistedFrom = 0;
+    log_d("Replayed %d journal entries", Cursor);
+}
+
+void MoveJournal::Compacted()
+{
+    WriteChunks(0);
+    PersistedFrom = Cursor;
+}
+
+void MoveJournal::Clear()
+{
+    WriteChunks(0);
+    History.clear();
+    Cursor = PersistedFrom = 0;
+}
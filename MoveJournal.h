@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include <Arduino.h>
+
+#include "Utility.h"
+
+class SudokuState;
+
+// One edit to one square, packed into 2 bytes
+struct JournalEntry
+{
+    enum eOp : uint8_t {
+        eAdd        = 0,    // AddPossible(digit)
+        eRemove     = 1,    // RemovePossible(digit)
+        eSet        = 2,    // SetSolution(digit) on a square with all nine possible
+    };
+
+    uint16_t    Bits = 0;   // cell:7 digit:4 op:2 group:1
+
+    JournalEntry() = default;
+    JournalEntry( uint8_t cell, uint8_t digit, eOp op, bool group )
+    : Bits(cell | digit << 7 | op << 11 | (group ? 1 << 13 : 0)) {};
+
+    uint8_t     Cell() const { return Bits & 0x7F; };           // y*N+x
+    uint8_t     Digit() const { return (Bits >> 7) & 0xF; };
+    eOp         Op() const { return (eOp)((Bits >> 11) & 0x3); };
+    bool        Group() const { return Bits & (1 << 13); };     // Undone and redone with the entry before
+};
+
+// Every edit to the current game is appended to this, giving undo/redo and a record in NVS
+// of the moves made since the last snapshot, so that a brownout loses nothing
+class MoveJournal
+{
+protected:
+    static constexpr uint8_t    ChunkEntries = 16;      // Entries per NVS key
+    static constexpr uint8_t    MaxChunks = 4;          // Snapshot and start again when full
+    static constexpr uint16_t   MaxHistory = 512;       // Undo depth kept in memory
+
+    std::vector<JournalEntry>   History;
+    uint16_t    Cursor = 0;             // Entries before this are applied, after it can be redone
+    uint16_t    PersistedFrom = 0;      // Entry at which the last snapshot was taken
+    uint16_t    PersistedCount = 0;     // Entries from PersistedFrom currently written to NVS
+
+    static void Apply( SudokuState& state, JournalEntry entry, bool forward );
+    void        Append( JournalEntry entry );
+    void        Persist( SudokuState& state );
+    void        WriteChunks( uint16_t count );
+
+public:
+    // All the undo history there will ever be, so that moves do not allocate
+    MoveJournal() { History.reserve(MaxHistory); };
+
+    // Applies the edit to the state and records it
+    void        Record( SudokuState& state, Point<uint8_t> square, JournalEntry::eOp op, uint8_t digit );
+    // Records every square that differs between the states as one undo step, state must already equal after.
+    // withPrevious makes it part of the step recorded before it.
+    void        RecordDiff( SudokuState& state, const SudokuState& before, bool withPrevious = false );
+
+    bool        CanUndo() const { return Cursor > 0; };
+    bool        CanRedo() const { return Cursor < History.size(); };
+    // Return the square changed, or (-1,-1) if there was nothing to do
+    Point<int8_t> Undo( SudokuState& state );
+    Point<int8_t> Redo( SudokuState& state );
+
+    // Replays the moves saved since the last snapshot onto the state
+    void        Restore( SudokuState& state );
+    // Called when a snapshot of the state has been saved
+    void        Compacted();
+    // Forgets everything, for a new or reloaded game
+    void        Clear();
+};
+
+extern MoveJournal Journal;
@@ -0,0 +1,109 @@
+#include "Perf.h"
+
+PerfStats Perf;
+
+#if PERF_ENABLED
+// Every new is counted, so that a hot path that allocates shows up on the diagnostics layout
+void* operator new( size_t size )
+{
+    Perf.Add(PerfStats::eHeapAllocs);
+    void* p = malloc(size ? size : 1);
+    if( !p )
+        abort();
+    return p;
+}
+
+void* operator new[]( size_t size )
+{
+    return operator new(size);
+}
+
+void operator delete( void* p ) noexcept
+{
+    free(p);
+}
+
+void operator delete[]( void* p ) noexcept
+{
+    free(p);
+}
+
+void operator delete( void* p, size_t ) noexcept
+{
+    free(p);
+}
+
+void operator delete[]( void* p, size_t ) noexcept
+{
+    free(p);
+}
+#endif
+
+const char* PerfStats::Name( eCounter counter )
+{
+    switch( counter )
+    {
+        case ePropagatePasses:  return "Propagate passes";
+        case eSolverNodes:      return "Solver nodes";
+        case eBacktracks:       return "Backtracks";
+        case eUniquenessCalls:  return "Uniqueness checks";
+        case eRatings:          return "Ratings";
+        case eItemsPainted:     return "Items painted";
+        case eGramBytes:        return "GRAM bytes";
+        case eHeapAllocs:       return "Heap allocations";
+        case eHeapChanges:      return "Heap changes";
+        default:                return "?";
+    }
+}
+
+const char* PerfStats::Name( eTimer timer )
+{
+    static const char* modeNames[] = { "EPD INIT", "EPD DU", "EPD GC16", "EPD GL16", "EPD GLR16", "EPD GLD16", "EPD DU4", "EPD A2", "EPD NONE" };
+    switch( timer )
+    {
+        case eTimerDraw:        return "Draw";
+        case eTimerCompose:     return "Compose";
+        default:                return modeNames[timer - eTimerEpd];
+    }
+}
+
+void PerfStats::Record( eTimer timer, uint32_t cycles )
+{
+    TimerStats& stats = Timers[timer];
+    stats.Count++;
+    stats.TotalCycles += cycles;
+    stats.MaxCycles = max(stats.MaxCycles, cycles);
+}
+
+void PerfStats::Describe( eCounter counter, TextBuffer& text ) const
+{
+    text << Name(counter) << ": " << Counters[counter];
+}
+
+void PerfStats::Describe( eTimer timer, TextBuffer& text ) const
+{
+    const TimerStats& stats = Timers[timer];
+    text << Name(timer) << ": " << stats.Count;
+    if( stats.Count == 0 )
+        return;
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    text << ", mean " << (uint32_t)(stats.TotalCycles / stats.Count / mhz) << "us, max " << stats.MaxCycles / mhz << "us";
+}
+
+void PerfStats::Reset()
+{
+    for( uint8_t i = 0 ; i < eCounterCount ; i++ )
+        Counters[i] = 0;
+    for( uint8_t i = 0 ; i < eTimerCount ; i++ )
+        Timers[i] = TimerStats();
+}
+
+void PerfStats::DumpCsv() const
+{
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    Serial.printf("kind,name,count,total_us,max_us\n");
+    for( uint8_t i = 0 ; i < eCounterCount ; i++ )
+        Serial.printf("counter,%s,%u,,\n", Name((eCounter)i), Counters[i]);
+    for( uint8_t i = 0 ; i < eTimerCount ; i++ )
+        Serial.printf("timer,%s,%u,%llu,%u\n", Name((eTimer)i), Timers[i].Count, Timers[i].TotalCycles / mhz, Timers[i].MaxCycles / mhz);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Arduino.h>
+#include <M5EPD.h>
+
+#include "Utility.h"
+
+// Set to 0 to compile all of the counting and timing out
+#ifndef PERF_ENABLED
+#define PERF_ENABLED 1
+#endif
+
+// Counters and cycle count timers for the hot paths, shown on the diagnostics layout
+// and dumped to serial as CSV
+class PerfStats
+{
+public:
+    enum eCounter : uint8_t {
+        ePropagatePasses,
+        eSolverNodes,
+        eBacktracks,
+        eUniquenessCalls,
+        eRatings,
+        eItemsPainted,
+        eGramBytes,
+        eHeapAllocs,            // Calls to operator new
+        eHeapChanges,           // Draws and touches that left the free heap different
+
+        eCounterCount
+    };
+
+    enum eTimer : uint8_t {
+        eTimerDraw,
+        eTimerCompose,          // Composing layers and writing GRAM
+        eTimerEpd,              // Issue to refresh complete, one per m5epd_update_mode_t
+        eTimerCount = eTimerEpd + UPDATE_MODE_NONE + 1
+    };
+
+    struct TimerStats
+    {
+        uint32_t    Count = 0;
+        uint64_t    TotalCycles = 0;
+        uint32_t    MaxCycles = 0;      // Timed scopes must be under 2^32 cycles, ~17s at 240MHz
+    };
+
+protected:
+    volatile uint32_t   Counters[eCounterCount] = {};
+    TimerStats          Timers[eTimerCount];
+
+public:
+    static uint32_t     Cycles() { return ESP.getCycleCount(); };
+    static eTimer       EpdTimer( m5epd_update_mode_t mode ) { return (eTimer)(eTimerEpd + min<uint8_t>(mode, UPDATE_MODE_NONE)); };
+    static const char*  Name( eCounter counter );
+    static const char*  Name( eTimer timer );
+
+    void        Add( eCounter counter, uint32_t n = 1 ) { Counters[counter] += n; };
+    void        Record( eTimer timer, uint32_t cycles );
+    uint32_t    Get( eCounter counter ) const { return Counters[counter]; };
+    const TimerStats& Get( eTimer timer ) const { return Timers[timer]; };
+
+    void        Describe( eCounter counter, TextBuffer& text ) const;
+    void        Describe( eTimer timer, TextBuffer& text ) const;
+    void        Reset();
+    void        DumpCsv() const;
+};
+
+extern PerfStats Perf;
+
+// Times from construction to destruction
+class PerfScope
+{
+protected:
+    PerfStats::eTimer   Timer;
+    uint32_t            Start;
+
+public:
+    PerfScope( PerfStats::eTimer timer ) : Timer(timer), Start(PerfStats::Cycles()) {};
+    ~PerfScope() { Perf.Record(Timer, PerfStats::Cycles() - Start); };
+};
+
+// Notes when the free heap is not the same at destruction as at construction,
+// which catches malloc and String as well as new
+class HeapCheck
+{
+protected:
+    uint32_t    Free;
+
+public:
+    HeapCheck() : Free(ESP.getFreeHeap()) {};
+    ~HeapCheck() { if( ESP.getFreeHeap() != Free ) Perf.Add(PerfStats::eHeapChanges); };
+};
+
+#if PERF_ENABLED
+#define PERF_COUNT(counter)         Perf.Add(PerfStats::counter)
+#define PERF_ADD(counter,n)         Perf.Add(PerfStats::counter,n)
+#define PERF_SCOPE(timer)           PerfScope perfScope_##timer(PerfStats::timer)
+#define PERF_RECORD(timer,cycles)   Perf.Record(timer,cycles)
+#define PERF_HEAP_CHECK()           HeapCheck heapCheck
+#else
+#define PERF_COUNT(counter)         do {} while( false )
+#define PERF_ADD(counter,n)         do {} while( false )
+#define PERF_SCOPE(timer)
+#define PERF_RECORD(timer,cycles)   do {} while( false )
+#define PERF_HEAP_CHECK()
+#endif
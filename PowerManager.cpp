@@ -0,0 +1,92 @@
+#include "PowerManager.h"
+
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <SD.h>
+
+#include "SaveSlots.h"
+
+PowerManager Power;
+
+RTC_DATA_ATTR PowerManager::ResumeState PowerManager::Saved;
+
+bool PowerManager::CheckResume()
+{
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    Resuming = (cause == ESP_SLEEP_WAKEUP_EXT0 || cause == ESP_SLEEP_WAKEUP_EXT1)
+        && Saved.Magic == ResumeMagic
+        && Saved.Crc == Crc32(&Saved, offsetof(ResumeState,Crc));
+    // Only ever resume from a given sleep once
+    Saved.Magic = 0;
+    log_d("Wake cause %d, resuming: %c", cause, Resuming?'Y':'N');
+    return Resuming;
+}
+
+void PowerManager::BeginAfterSleep()
+{
+    // Drive the power pins before releasing them, or the board switches itself off
+    pinMode(M5EPD_MAIN_PWR_PIN, OUTPUT);
+    M5.enableMainPower();
+    pinMode(M5EPD_EPD_PWR_EN_PIN, OUTPUT);
+    M5.enableEPDPower();
+    gpio_hold_dis((gpio_num_t)M5EPD_MAIN_PWR_PIN);
+    gpio_hold_dis((gpio_num_t)M5EPD_EPD_PWR_EN_PIN);
+    gpio_deep_sleep_hold_dis();
+
+    Serial.begin(115200);
+    pinMode(M5EPD_EXT_PWR_EN_PIN, OUTPUT);
+    pinMode(M5EPD_KEY_RIGHT_PIN, INPUT);
+    pinMode(M5EPD_KEY_PUSH_PIN, INPUT);
+    pinMode(M5EPD_KEY_LEFT_PIN, INPUT);
+    M5.enableEXTPower();
+
+    M5.EPD.begin(M5EPD_SCK_PIN, M5EPD_MOSI_PIN, M5EPD_MISO_PIN, M5EPD_CS_PIN, M5EPD_BUSY_PIN);
+    M5.EPD.Active();
+    M5.TP.begin(21, 22, GT911_INT_PIN);
+    // For the puzzle collection
+    SPI.begin(14, 13, 12, 4);
+    SD.begin(4, SPI, 20000000);
+    M5.BatteryADCBegin();
+}
+
+bool PowerManager::Restore( SudokuState& state, Point<uint8_t>& currentSquare, TextBuffer& lastValidation ) const
+{
+    SudokuSaveBlob blob;
+    memcpy(&blob, Saved.Game, sizeof(blob));
+    if( !state.FromBlob(blob) )
+        return false;
+    // The same blob was written to NVS before sleeping
+    Saves.MarkSaved(blob);
+    currentSquare = Point<uint8_t>(Saved.CurrentX, Saved.CurrentY);
+    lastValidation = Saved.LastValidation;
+    return true;
+}
+
+void PowerManager::DeepSleep( const SudokuState& state, Point<uint8_t> currentSquare, const TextBuffer& lastValidation, int8_t layout, uint16_t rotation, uint32_t canvasCrc )
+{
+    SudokuSaveBlob blob;
+    state.ToBlob(blob);
+    memcpy(Saved.Game, &blob, sizeof(blob));
+    Saved.Layout = layout;
+    Saved.Rotation = rotation;
+    Saved.CurrentX = currentSquare.x;
+    Saved.CurrentY = currentSquare.y;
+    strlcpy(Saved.LastValidation, lastValidation.c_str(), sizeof(Saved.LastValidation));
+    Saved.CanvasCrc = canvasCrc;
+    Saved.Magic = ResumeMagic;
+    Saved.Crc = Crc32(&Saved, offsetof(ResumeState,Crc));
+
+    // Keep the board and the EPD powered, the panel controller just sleeps
+    M5.EPD.Sleep();
+    gpio_hold_en((gpio_num_t)M5EPD_MAIN_PWR_PIN);
+    gpio_hold_en((gpio_num_t)M5EPD_EPD_PWR_EN_PIN);
+    gpio_deep_sleep_hold_en();
+
+    // ext1 can only wake on all pins low, so only the wheel push is used
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)GT911_INT_PIN, 0);
+    esp_sleep_enable_ext1_wakeup(1ULL << M5EPD_KEY_PUSH_PIN, ESP_EXT1_WAKEUP_ALL_LOW);
+
+    log_d("Entering deep sleep");
+    esp_deep_sleep_start();
+}
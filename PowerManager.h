@@ -0,0 +1,58 @@
+#pragma once
+
+#include <M5EPD.h>
+#include <type_traits>
+
+#include "Utility.h"
+#include "SudokuState.h"
+
+// Deep sleeps the ESP32 on inactivity with the game kept in RTC memory, so that waking
+// skips M5.begin(), the NVS reads and clearing the EPD
+class PowerManager
+{
+public:
+    static constexpr uint32_t   CriticalBatteryMV = 3300;   // Below this power off completely instead
+
+protected:
+    static constexpr uint32_t   ResumeMagic = 0x5344534C;
+
+    // Everything needed to put the screen back as it was, survives deep sleep but not power off
+    // Must stay trivially constructible, static constructors run again on every wake
+    struct ResumeState
+    {
+        uint32_t        Magic;
+        uint8_t         Game[sizeof(SudokuSaveBlob)];
+        int8_t          Layout;
+        uint16_t        Rotation;
+        uint8_t         CurrentX;
+        uint8_t         CurrentY;
+        char            LastValidation[16];
+        uint32_t        CanvasCrc;      // Of the canvas as last sent to the panel
+        uint32_t        Crc;            // Of everything above
+    };
+    static ResumeState  Saved;
+    static_assert(std::is_trivially_default_constructible<ResumeState>::value, "ResumeState would be reset on wake");
+
+    bool    Resuming = false;
+
+public:
+    // Call first thing in setup, true if woken from deep sleep with a valid saved state
+    bool    CheckResume();
+    bool    IsResuming() const { return Resuming; };
+    void    ResumeComplete() { Resuming = false; };
+
+    // Brings up only what M5.begin() would, without waiting for the EPD to power up as it never went off
+    void    BeginAfterSleep();
+
+    int8_t          GetLayout() const { return Saved.Layout; };
+    uint16_t        GetRotation() const { return Saved.Rotation; };
+    uint32_t        GetCanvasCrc() const { return Saved.CanvasCrc; };
+    bool            Restore( SudokuState& state, Point<uint8_t>& currentSquare, TextBuffer& lastValidation ) const;
+
+    bool    IsBatteryCritical( uint32_t batteryMV ) const { return batteryMV <= CriticalBatteryMV; };
+
+    // Does not return, wakes on touch or the wheel being pushed
+    void    DeepSleep( const SudokuState& state, Point<uint8_t> currentSquare, const TextBuffer& lastValidation, int8_t layout, uint16_t rotation, uint32_t canvasCrc );
+};
+
+extern PowerManager Power;
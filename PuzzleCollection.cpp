@@ -0,0 +1,152 @@
+#include <algorithm>
+
+#include <esp_heap_caps.h>
+
+#include "PuzzleCollection.h"
+
+PuzzleCollection Collection;
+
+static void* AllocateIndex( size_t size )
+{
+    void* data = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    return data ? data : malloc(size);
+}
+
+void PuzzleCollection::Begin( const char* path )
+{
+    uint8_t notStarted = eNotStarted;
+    if( !Status.compare_exchange_strong(notStarted, eIndexing) )
+        return;
+    Path = path;
+    // Lowest priority, so the UI and the display task are never held up
+    if( xTaskCreatePinnedToCore(IndexTask, "Collection", 4*1024, this, 0, nullptr, 0) != pdPASS )
+        Status = eFailed;
+}
+
+void PuzzleCollection::IndexTask( void* param )
+{
+    PuzzleCollection* collection = (PuzzleCollection*)param;
+    collection->Open(collection->Path);
+    vTaskDelete(nullptr);
+}
+
+bool PuzzleCollection::Open( const char* path )
+{
+    Close();
+    Status = eIndexing;
+    Source = SD.open(path, FILE_READ);
+    if( !Source )
+    {
+        log_d("No puzzle collection at %s", path);
+        Status = eFailed;
+        return false;
+    }
+
+    // Every puzzle takes at least 81 bytes and a line break, except perhaps the last.
+    // Blocks end after BlockSize puzzles or 64KB, whichever comes first.
+    Capacity = Source.size()/82 + 1;
+    MaxBlocks = Capacity/BlockSize + Source.size()/0x10000 + 2;
+    BlockStarts = (uint32_t*)AllocateIndex(MaxBlocks * sizeof(uint32_t));
+    BlockFirst = (uint32_t*)AllocateIndex(MaxBlocks * sizeof(uint32_t));
+    Offsets = (uint16_t*)AllocateIndex(Capacity * sizeof(uint16_t));
+    auto ts = millis();
+    if( !BlockStarts || !BlockFirst || !Offsets || !Index() || Count == 0 )
+    {
+        log_d("Cannot index %s", path);
+        Close();
+        Status = eFailed;
+        return false;
+    }
+    log_d("%u puzzles in %u blocks in %s, indexed in %ums", Count, Blocks, path, (uint32_t)(millis() - ts));
+    Status = eReady;
+    return true;
+}
+
+void PuzzleCollection::Close()
+{
+    if( Source )
+        Source.close();
+    free(BlockStarts);
+    free(BlockFirst);
+    free(Offsets);
+    BlockStarts = nullptr;
+    BlockFirst = nullptr;
+    Offsets = nullptr;
+    Count = Capacity = Blocks = MaxBlocks = 0;
+    // Leaves a failed or running open as it is
+    uint8_t ready = eReady;
+    Status.compare_exchange_strong(ready, eNotStarted);
+}
+
+bool PuzzleCollection::Add( uint32_t offset )
+{
+    if( Count == Capacity )
+        return false;
+    if( Blocks == 0 || Count - BlockFirst[Blocks-1] == BlockSize || offset - BlockStarts[Blocks-1] > 0xFFFF )
+    {
+        if( Blocks == MaxBlocks )
+            return false;
+        BlockStarts[Blocks] = offset;
+        BlockFirst[Blocks] = Count;
+        Blocks++;
+    }
+    Offsets[Count++] = offset - BlockStarts[Blocks-1];
+    return true;
+}
+
+// Line by line, carrying the state of the current line from one chunk to the next
+bool PuzzleCollection::Index()
+{
+    static uint8_t chunk[ChunkSize];
+    uint32_t lineStart = 0;
+    uint8_t length = 0;         // Of the puzzle so far
+    bool skipping = false;      // Not a puzzle, or already added
+    uint32_t position = 0;
+    Source.seek(0);
+    for( int read ; (read = Source.read(chunk, ChunkSize)) > 0 ; position += read )
+        for( int i = 0 ; i < read ; i++ )
+        {
+            char c = chunk[i];
+            if( c == '\n' || c == '\r' )
+            {
+                if( !skipping && length == 81 && !Add(lineStart) )
+                    return false;
+                lineStart = position + i + 1;
+                length = 0;
+                skipping = false;
+            }
+            else if( skipping )
+                continue;
+            else if( length < 81 )
+            {
+                if( (c >= '0' && c <= '9') || c == '.' )
+                    length++;
+                else
+                    skipping = true;
+            }
+            else
+            {
+                if( (c == ' ' || c == '\t' || c == ',') && !Add(lineStart) )
+                    return false;
+                skipping = true;
+            }
+        }
+    if( !skipping && length == 81 && !Add(lineStart) )
+        return false;
+    return true;
+}
+
+bool PuzzleCollection::Read( uint32_t number, char* text )
+{
+    if( number >= GetCount() )
+        return false;
+    uint32_t block = std::upper_bound(BlockFirst, BlockFirst + Blocks, number) - BlockFirst - 1;
+    uint32_t offset = BlockStarts[block] + Offsets[number];
+    return Source.seek(offset) && Source.read((uint8_t*)text, 81) == 81;
+}
+
+bool PuzzleCollection::Load( uint32_t number, SudokuState& state )
+{
+    char text[81];
+    return Read(number, text) && state.GenerateFromText(text);
+}
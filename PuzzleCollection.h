@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "SudokuState.h"
+
+// A text file of puzzles on the SD card, one to a line as 81 characters with '.' or '0' for an empty square,
+// followed by nothing or by a space, tab or comma and anything else. Other lines are skipped.
+// Opening reads the file once in fixed size chunks to find where each puzzle starts. The index keeps a 32 bit
+// offset for each block of puzzles and a 16 bit one from there for each puzzle, in PSRAM if there is any,
+// so any puzzle can then be read with a single seek without the file ever being held in memory.
+// Begin does the opening on a low priority task, once: a file that is missing or cannot be indexed is not
+// looked for again until the next restart.
+class PuzzleCollection
+{
+public:
+    static constexpr const char* DefaultPath = "/puzzles.txt";
+    static constexpr uint16_t ChunkSize = 512;
+    static constexpr uint8_t  BlockSize = 64;       // Puzzles to a block, fewer if they are more than 64KB apart
+
+    enum eStatus : uint8_t {
+        eNotStarted,
+        eIndexing,
+        eReady,
+        eFailed,
+    };
+
+    ~PuzzleCollection() { Close(); };
+
+    void            Begin( const char* path = DefaultPath );
+    bool            Open( const char* path = DefaultPath );     // returns false if there are no puzzles to read
+    void            Close();
+    eStatus         GetStatus() const { return (eStatus)Status.load(); };
+    bool            IsOpen() const { return Status == eReady; };
+    uint32_t        GetCount() const { return IsOpen() ? Count : 0; };
+
+    bool            Read( uint32_t number, char* text );        // text gets the puzzle's 81 characters
+    bool            Load( uint32_t number, SudokuState& state );
+
+protected:
+    File            Source;
+    const char*     Path = DefaultPath;
+    std::atomic<uint8_t> Status{eNotStarted};
+    uint32_t        Count = 0;
+    uint32_t        Capacity = 0;
+    uint32_t        Blocks = 0;
+    uint32_t        MaxBlocks = 0;
+    uint32_t*       BlockStarts = nullptr;  // Offset in the file of each block
+    uint32_t*       BlockFirst = nullptr;   // Number of the first puzzle in each block
+    uint16_t*       Offsets = nullptr;      // From the start of the puzzle's block
+
+    bool            Add( uint32_t offset );     // returns false if the index is full
+    bool            Index();
+    static void     IndexTask( void* );
+};
+
+extern PuzzleCollection Collection;
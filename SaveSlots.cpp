@@ -0,0 +1,232 @@
+#include "SaveSlots.h"
+
+#include <Preferences.h>
+
+extern Preferences preferences;
+extern const char* Preferences_App;
+
+SaveSlots Saves;
+
+static const char* IndexKey = "Index";
+static const char* SingleGameKey = "Game";      // The one save before slots
+
+const char* SaveSlots::SlotKey( uint8_t slot )
+{
+    static const char* const keys[] = { "Slot0", "Slot1", "Slot2", "Slot3", "Slot4", "Slot5" };
+    static_assert(sizeof(keys)/sizeof(keys[0]) == SaveIndexBlob::MaxSlots, "One key per slot");
+    return keys[slot];
+}
+
+void SaveSlots::LoadIndex()
+{
+    if( IndexLoaded )
+        return;
+    IndexLoaded = true;
+
+    // Older versions are smaller, and are read as bytes to be upgraded
+    uint8_t data[sizeof(Index)];
+    preferences.begin(Preferences_App);
+    size_t length = preferences.getBytesLength(IndexKey);
+    if( length == sizeof(Index) )
+        length = preferences.getBytes(IndexKey, &Index, sizeof(Index));
+    else if( length < sizeof(data) )
+        length = preferences.getBytes(IndexKey, data, sizeof(data));
+    preferences.end();
+    if( length == sizeof(Index) )
+    {
+        if( Index.Version == SaveIndexBlob::CurrentVersion && Index.Crc == Index.CalculateCrc() )
+            return;
+    }
+    else if( UpgradeIndex(data, length) )
+        return;
+
+    log_d("No valid save index (%d bytes)", (int)length);
+    Index = SaveIndexBlob();
+    Migrate();
+}
+
+template <class T>
+static T ReadField( const uint8_t*& data )
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return value;
+}
+
+// Version 1 slots stopped before the hash, which is worked out when each game is next saved
+bool SaveSlots::UpgradeIndex( const uint8_t* data, size_t length )
+{
+    const size_t headerV1 = 1 + 1 + 4;          // Version, Current, Sequence
+    const size_t slotV1 = 1 + 1 + 1 + 4 + 4;    // Flags, Clues, Filled, ElapsedS, LastPlayed
+    uint32_t crc;
+    if( length != headerV1 + SaveIndexBlob::MaxSlots*slotV1 + sizeof(crc) || data[0] != 1 )
+        return false;
+    memcpy(&crc, data + length - sizeof(crc), sizeof(crc));
+    if( crc != Crc32(data, length - sizeof(crc)) )
+        return false;
+
+    log_d("Upgrading save index from version 1");
+    Index = SaveIndexBlob();
+    const uint8_t* read = data + 1;
+    Index.Current = ReadField<uint8_t>(read);
+    Index.Sequence = ReadField<uint32_t>(read);
+    for( uint8_t slot = 0 ; slot < SaveIndexBlob::MaxSlots ; slot++ )
+    {
+        SaveSlotInfo& info = Index.Slots[slot];
+        info.Flags = ReadField<uint8_t>(read);
+        info.Clues = ReadField<uint8_t>(read);
+        info.Filled = ReadField<uint8_t>(read);
+        info.ElapsedS = ReadField<uint32_t>(read);
+        info.LastPlayed = ReadField<uint32_t>(read);
+    }
+    WriteIndex();
+    return true;
+}
+
+// Older versions had a single save, that becomes slot 0
+void SaveSlots::Migrate()
+{
+    SudokuState state;
+    SudokuSaveBlob blob;
+    preferences.begin(Preferences_App);
+    size_t length = preferences.getBytes(SingleGameKey, &blob, sizeof(blob));
+    preferences.end();
+
+    bool found = length == sizeof(blob) && state.FromBlob(blob);
+    if( !found )
+        found = SudokuState::LoadLegacy(state);
+    if( !found )
+        return;
+
+    log_d("Moving old save to slot 0");
+    Index.Current = 0;
+    PlayStartMS = millis();
+    if( !Save(state) )
+        return;
+
+    preferences.begin(Preferences_App);
+    preferences.remove(SingleGameKey);
+    preferences.end();
+}
+
+void SaveSlots::WriteIndex()
+{
+    Index.Crc = Index.CalculateCrc();
+    preferences.begin(Preferences_App);
+    preferences.putBytes(IndexKey, &Index, sizeof(Index));
+    preferences.end();
+}
+
+void SaveSlots::Describe( uint8_t slot, TextBuffer& text )
+{
+    const SaveSlotInfo& info = GetInfo(slot);
+    text << slot+1 << ": ";
+    if( !info.InUse() )
+    {
+        text << "Empty";
+        return;
+    }
+    if( info.Clues > 0 )
+        text << info.Clues << " clues, ";
+    if( info.Flags & SaveSlotInfo::eSolved )
+        text << "solved, ";
+    else
+        text << info.Filled << "/81, ";
+    text << info.ElapsedS / 60 << " min";
+}
+
+bool SaveSlots::HasPuzzle( uint64_t hash )
+{
+    LoadIndex();
+    for( uint8_t slot = 0 ; slot < SaveIndexBlob::MaxSlots ; slot++ )
+        if( Index.Slots[slot].InUse() && Index.Slots[slot].Hash == hash )
+            return true;
+    return false;
+}
+
+bool SaveSlots::Save( const SudokuState& state )
+{
+    LoadIndex();
+    SudokuSaveBlob blob;
+    state.ToBlob(blob);
+    SaveSlotInfo& info = Index.Slots[Index.Current];
+    // Nothing to do if this is what was last written, saves flash wear on every shutdown
+    if( info.InUse() && blob.Crc == LastSavedCrc )
+        return true;
+
+    uint32_t now = millis();
+    info.ElapsedS += (now - PlayStartMS) / 1000;
+    PlayStartMS = now - (now - PlayStartMS) % 1000;
+    info.Flags = SaveSlotInfo::eInUse | (state.Solved() ? SaveSlotInfo::eSolved : 0);
+    info.Clues = state.CountGivens();
+    info.Filled = state.CountFixed();
+    info.LastPlayed = ++Index.Sequence;
+    if( info.Hash == 0 )
+        info.Hash = state.CanonicalHash();
+
+    preferences.begin(Preferences_App);
+    bool written = preferences.putBytes(SlotKey(Index.Current), &blob, sizeof(blob)) == sizeof(blob);
+    // Read back, as the journal is thrown away once this succeeds
+    SudokuSaveBlob check;
+    written = written && preferences.getBytes(SlotKey(Index.Current), &check, sizeof(check)) == sizeof(check)
+        && memcmp(&check, &blob, sizeof(blob)) == 0;
+    preferences.end();
+    if( !written )
+    {
+        log_d("Failed to save slot %d", Index.Current);
+        return false;
+    }
+    WriteIndex();
+    LastSavedCrc = blob.Crc;
+    return true;
+}
+
+bool SaveSlots::Load( SudokuState& state, uint8_t slot )
+{
+    LoadIndex();
+    if( slot >= SaveIndexBlob::MaxSlots || !Index.Slots[slot].InUse() )
+        return false;
+
+    SudokuSaveBlob blob;
+    preferences.begin(Preferences_App);
+    size_t length = preferences.getBytes(SlotKey(slot), &blob, sizeof(blob));
+    preferences.end();
+    if( length != sizeof(blob) || !state.FromBlob(blob) )
+    {
+        log_d("Slot %d is not valid (%d bytes)", slot, (int)length);
+        return false;
+    }
+
+    if( slot != Index.Current )
+    {
+        Index.Current = slot;
+        Index.Slots[slot].LastPlayed = ++Index.Sequence;
+        WriteIndex();
+    }
+    LastSavedCrc = blob.Crc;
+    PlayStartMS = millis();
+    return true;
+}
+
+void SaveSlots::StartNew( const SudokuState& state )
+{
+    LoadIndex();
+    uint8_t slot = SaveIndexBlob::MaxSlots;
+    for( uint8_t i = 0 ; i < SaveIndexBlob::MaxSlots && slot == SaveIndexBlob::MaxSlots ; i++ )
+        if( !Index.Slots[i].InUse() )
+            slot = i;
+    if( slot == SaveIndexBlob::MaxSlots )
+    {
+        slot = Index.Current == 0 ? 1 : 0;
+        for( uint8_t i = 0 ; i < SaveIndexBlob::MaxSlots ; i++ )
+            if( i != Index.Current && Index.Slots[i].LastPlayed < Index.Slots[slot].LastPlayed )
+                slot = i;
+    }
+    log_d("New game in slot %d", slot);
+
+    Index.Current = slot;
+    Index.Slots[slot] = SaveSlotInfo();
+    PlayStartMS = millis();
+    Save(state);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Utility.h"
+#include "SudokuState.h"
+
+// Summary of one saved game, kept in the index so listing games needs a single read
+struct __attribute__((packed)) SaveSlotInfo
+{
+    enum eFlags : uint8_t {
+        eInUse      = 1 << 0,
+        eSolved     = 1 << 1,
+    };
+
+    uint8_t     Flags = 0;
+    uint8_t     Clues = 0;          // 0 for games from before givens were recorded
+    uint8_t     Filled = 0;         // Squares with a single value
+    uint32_t    ElapsedS = 0;       // Time spent playing
+    uint32_t    LastPlayed = 0;     // SaveIndexBlob::Sequence when last saved or loaded
+    uint64_t    Hash = 0;           // SudokuState::CanonicalHash, 0 if not worked out yet
+
+    bool        InUse() const { return Flags & eInUse; };
+};
+
+struct __attribute__((packed)) SaveIndexBlob
+{
+    static constexpr uint8_t CurrentVersion = 2;
+    static constexpr uint8_t MaxSlots = 6;
+
+    uint8_t     Version = CurrentVersion;
+    uint8_t     Current = 0;
+    uint32_t    Sequence = 0;
+    SaveSlotInfo Slots[MaxSlots];
+    uint32_t    Crc = 0;            // Of everything above
+
+    uint32_t    CalculateCrc() const { return Crc32(this, offsetof(SaveIndexBlob,Crc)); };
+};
+
+// Several games in NVS: an "Index" blob describing the slots, plus one SudokuSaveBlob per slot.
+// The index is read the first time it is needed, which is not at all on a resume from deep sleep.
+class SaveSlots
+{
+protected:
+    SaveIndexBlob   Index;
+    bool            IndexLoaded = false;
+    uint32_t        LastSavedCrc = 0;   // Of the current slot's blob
+    uint32_t        PlayStartMS = 0;    // Play time since then has not been added to ElapsedS yet
+
+    void            LoadIndex();
+    bool            UpgradeIndex( const uint8_t* data, size_t length );
+    void            WriteIndex();
+    void            Migrate();
+    static const char*  SlotKey( uint8_t slot );
+
+public:
+    uint8_t         GetCurrent() { LoadIndex(); return Index.Current; };
+    const SaveSlotInfo& GetInfo( uint8_t slot ) { LoadIndex(); return Index.Slots[slot]; };
+    void            Describe( uint8_t slot, TextBuffer& text );
+    // returns true if a saved game is the same puzzle, apart from symmetry or relabelling
+    bool            HasPuzzle( uint64_t hash );
+
+    // Writes the state to the current slot, unless it is unchanged since the last write.
+    // Returns false if it could not be written and read back.
+    bool            Save( const SudokuState& state );
+    bool            LoadCurrent( SudokuState& state ) { return Load(state, GetCurrent()); };
+    // Makes slot current
+    bool            Load( SudokuState& state, uint8_t slot );
+    // Puts a new game in an empty slot, or the least recently played one that is not current
+    void            StartNew( const SudokuState& state );
+    // For when the blob is known to match the current slot, after deep sleep
+    void            MarkSaved( const SudokuSaveBlob& blob ) { LastSavedCrc = blob.Crc; PlayStartMS = millis(); };
+};
+
+extern SaveSlots Saves;
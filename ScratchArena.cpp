@@ -0,0 +1,47 @@
+#include <esp_heap_caps.h>
+
+#include "ScratchArena.h"
+
+ScratchArena Scratch;
+
+bool ScratchArena::Reserve( size_t size )
+{
+    Release();
+    Data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if( !Data )
+        Data = (uint8_t*)malloc(size);
+    if( !Data )
+    {
+        log_d("Cannot reserve %u bytes of scratch", (uint32_t)size);
+        return false;
+    }
+    Size = size;
+    return true;
+}
+
+void ScratchArena::Release()
+{
+    free(Data);
+    Data = nullptr;
+    Size = Top = HighWater = 0;
+    Overflowed = false;
+}
+
+void* ScratchArena::Allocate( size_t size, size_t align )
+{
+    if( !Data && !Reserve() )
+    {
+        Overflowed = true;
+        return nullptr;
+    }
+    size_t start = (Top + align - 1) & ~(align - 1);
+    if( start + size > Size )
+    {
+        log_d("Scratch full, %u bytes wanted with %u of %u used", (uint32_t)size, (uint32_t)Top, (uint32_t)Size);
+        Overflowed = true;
+        return nullptr;
+    }
+    Top = start + size;
+    HighWater = max(HighWater, Top);
+    return Data + start;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Working memory for one job at a time, such as generating a game or checking one, taken from a single
+// block reserved once, in PSRAM if there is any. Allocating moves the top of the arena up, and a Mark
+// puts it back when it goes out of scope, so nothing is freed or fragmented and nothing touches the heap.
+// Reset starts the next job from the bottom again, the high water mark gives the largest job's working set.
+// Running out is not fatal: New returns nullptr and the arena stays marked as overflowed until the next Reset,
+// so a job can tell an answer that was cut short from a real one.
+class ScratchArena
+{
+public:
+    static constexpr size_t DefaultSize = 48*1024;     // A 9x9 game needs a few KB, and 10KB more at the deepest guess
+
+    // Everything allocated after the mark is given back when it goes out of scope
+    class Mark
+    {
+    protected:
+        ScratchArena&   Arena;
+        size_t          Top;
+
+    public:
+        Mark( ScratchArena& arena ) : Arena(arena), Top(arena.Top) {};
+        ~Mark() { Arena.Top = Top; };
+    };
+
+    ScratchArena() = default;
+    ScratchArena( const ScratchArena& ) = delete;
+    ScratchArena& operator=( const ScratchArena& ) = delete;
+    ~ScratchArena() { Release(); };
+
+    bool        Reserve( size_t size = DefaultSize );       // returns false if there is not the memory for it
+    void        Release();
+    void        Reset() { Top = 0; Overflowed = false; };
+
+    // nullptr if the arena is full, which marks it overflowed, reserving DefaultSize first if nothing has been
+    void*       Allocate( size_t size, size_t align = alignof(void*) );
+    template <class T, class... Args> T* New( Args&&... args )
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Nothing in the arena is destroyed");
+        void* p = Allocate(sizeof(T), alignof(T));
+        return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+    }
+    size_t      GetSize() const { return Size; };
+    size_t      GetUsed() const { return Top; };
+    size_t      GetHighWater() const { return HighWater; };
+    bool        HasOverflowed() const { return Overflowed; };
+
+protected:
+    uint8_t*    Data = nullptr;
+    size_t      Size = 0;
+    size_t      Top = 0;
+    size_t      HighWater = 0;
+    bool        Overflowed = false;     // An allocation failed since the last Reset
+};
+
+// For jobs run on the UI task, other tasks have their own
+extern ScratchArena Scratch;
@@ -0,0 +1,85 @@
+#include <random>
+
+#include "SeedBank.h"
+
+extern std::mt19937 g_;
+
+static constexpr uint8_t SeedsPerLevel = 12;
+
+// From DifficultyRater::Generate, each checked to have a unique solution
+static const char* const Seeds[DifficultyBand::eLevelCount][SeedsPerLevel] = {
+    {   // Easy
+        "...24...3.68..9..72.978.4..75.894....2.5.7...8.....7.5.879.5.4.....7.5..69.42....",     // 34 clues, Hidden single
+        "....84..9.5893.....345....82..7..4.3..3.26.57.4..53.26..726.........7....863..2.1",     // 34 clues, Hidden single
+        "8....36....91..8...3..4.2..48.9713..3..4.....91..3..7..416879...7......269352....",     // 34 clues, Naked single
+        "..7631.5..6...8.925.8.29..67...8354.4.....2........6872....7.6...41.2..3..9.5..2.",     // 34 clues, Hidden single
+        "1.925836..247..5.......3.97.5..7..21..2.9....8.76......4..261.....947.5..9.18....",     // 34 clues, Naked single
+        ".853.1.4.47.298..139........2.96.........5...6.983...4..25..6.7.47..32..56.7....8",     // 34 clues, Hidden single
+        "6.475..3.5.8...2..3..8...41.4..983.6...4...15..36..9.......61...8..4..72..62..493",     // 34 clues, Hidden single
+        "..5...68..6.9..543.4...6.2.6.4.2..91.71.4.3.....8.3.6.1534.2.....25.....4.6..7.3.",     // 34 clues, Naked single
+        ".2..3..6..816....7...1.5..46...58719..83.......546.8.2..78..293.9..2.....6...1.85",     // 34 clues, Naked single
+        "1.6.4.........6..443895.2....41.9..5..53.2.7......53.12..5.8..3953..4..8.4.....52",     // 34 clues, Hidden single
+        "2.1....93...34..5.34.25...1.2..3....8.3.1...669..7.3...1.8.3..4.68.2.1....2.95.7.",     // 34 clues, Hidden single
+        ".32......5..3...4..418..6..4.3..5.7189.641352.1......63..9.8..4..4..29..1......67",     // 34 clues, Naked single
+    },
+    {   // Medium
+        ".1.2.5......174.3.......5..1.4...2....8..6....2....7......6..5.57..829....9....4.",     // 24 clues, Naked subset
+        ".7..5.....531.2.7....3..9.....5317....9.....3..7..82....2.6.....9.....42.8...5.16",     // 27 clues, Locked candidates
+        "3...6.7...6.1.......4.8..........2.7547....1..1.....4.4765.8..9..1.94.8.8......7.",     // 27 clues, Locked candidates
+        "2.4..7........2..398..4..6..51...7.47..1..3.....5791..5...1......2.......19.3..5.",     // 27 clues, Locked candidates
+        "..3.....66.......7.27.93.8..457.63....9..1....6....5.....45..7..7.8.......8...65.",     // 26 clues, Locked candidates
+        ".2...6.......21...7....4.8...7.9..2.35.17.4...1.........5.8..32.4.....56....6.91.",     // 26 clues, Locked candidates
+        ".2......956...4.1..1.58.74.9...412...5.....9.8......3..9.367.2.....1....6.5.29...",     // 29 clues, Locked candidates
+        "2.1.5.......79..6.9.......8.9..75.4.4....2..3..7..9...1..3..6...4....81..8....3.5",     // 26 clues, Naked subset
+        "..92.7......5....3....1....492.3.8.1...87.3.4.8..9...5.51......7.63..5...4...9...",     // 27 clues, Naked subset
+        "......2..9.5.2..18.1...6.5.5...84.6...4...7...32.....4.7.5.....3..8.2.....9.6..75",     // 27 clues, Locked candidates
+        "8..325.....36..1......97..89.28.1.7....562.....17..3....4...........6241......6..",     // 27 clues, Locked candidates
+        "...7....9........8918..2......3..8.......1....97..843..2...3....812....55...7.6..",     // 24 clues, Naked subset
+    },
+    {   // Hard
+        ".9..2.85....1.4..942.968....3.5..9..9.7..2.415.2...3...5.2..4988.....672..98..1.5",     // 36 clues, Colouring
+        ".8.....92.35..84..6...948.5...9...63....2.948..38.6.2.....3.7..369187...817452..9",     // 38 clues, Colouring
+        "....6...5.13..5..7.......2.9.8.2.....4.3.1.6.13.9...5..6...317....8..2....96....3",     // 27 clues, Colouring
+        "7.......6.41.9...3...651......97.....5..86.1.9.....7.........745.4..7.2.2...139..",     // 27 clues, Colouring
+        "3...62481.6.7.15.3....3...7..6.1.73..........87.2..15....6.4...72.....6.65...78.4",     // 32 clues, Colouring
+        "7.6.43...5.4...68..2965....46........5897.31...3.8...684.537..9.9..6....6....182.",     // 35 clues, Colouring
+        ".....89.1.38.9...5...5...281.....67..56.......89.1.......1.7....7.....93.6583...7",     // 28 clues, Colouring
+        ".64.2....59.6.1..4.3..9..6....4.....3...176.8..8.6..91....46.1.1..7.2........97..",     // 29 clues, Colouring
+        "6...19..2..3..2..57.....4..97.3.....2...4.1..5..6..9.3.6...58.4.2..6.5....5....7.",     // 28 clues, Colouring
+        "....3.281....9....7....83...1.9...3..3.4.5..79.....8...285...76179.6...8..6879...",     // 31 clues, Colouring
+        ".....9.1739.71.48...1.3..5248......9..3......6.....7.4..762.5.8.36.7.2912....1..3",     // 34 clues, Colouring
+        ".5....6.2..86.24...6.7.9.....4.8..5...9....6.....9.713.....5...8..92..4.7....13..",     // 27 clues, Colouring
+    },
+    {   // Expert
+        "4.236...7..9.872.........56..61..5...9.....1......3.68971........4.7......8.5..2.",     // 27 clues, Guessing
+        "2..3...1...17..6.9.......84.6..391....258...33....789.....5.....4.9.2..15...1.97.",     // 30 clues, Guessing
+        "....1.3.2.7....169...9...7.........37325...91.594..7...96..8....4..52.1..1.....3.",     // 29 clues, Guessing
+        "...31..9.2.3.4.5...6...7...6.4...8.381..3..2.3.......4...8592.6..6...3..4..26..17",     // 31 clues, Guessing
+        "98.1.......1984....43........862...7.7.4...3143.51.....5..4...98....5..4......52.",     // 29 clues, Guessing
+        "...3.154..9...8..6......3...1..2.8..7...1...4..697..1.5.21..4....9..2..5.67......",     // 27 clues, Guessing
+        "426.....9.1..6..8....9...4.........5.918.6..776...4....32..5..41.....3.69..61..5.",     // 29 clues, Guessing
+        "....5..7.8...41.6.3.5..94..2.1........68...1.9....67.31.9..7.3.....8..........956",     // 27 clues, Guessing
+        "..83.6............4..81.27.6..1...97.5.94.3.2.3....5...4....9..5..6.9..3....7....",     // 26 clues, Guessing
+        ".....278.1...5..3.......4.6.9.8....1.73.9......46...........2..7.14.......9..3...",     // 22 clues, Guessing
+        "..2..9...........9..6.1.53...539.7.6....4.38.4...65...8..9...2357.28...4.........",     // 27 clues, Guessing
+        ".356.......2.3..4.....7...3....5....26............64.1..73.5.9...9.47...45..2.78.",     // 26 clues, Guessing
+    },
+};
+
+uint8_t SeedBank::Count( DifficultyBand::eLevel level )
+{
+    return level < DifficultyBand::eLevelCount ? SeedsPerLevel : 0;
+}
+
+const char* SeedBank::Seed( DifficultyBand::eLevel level, uint8_t index )
+{
+    return Seeds[level][index];
+}
+
+bool SeedBank::Draw( SudokuState& state, DifficultyBand::eLevel level )
+{
+    if( Count(level) == 0 || !state.GenerateFromText(Seed(level, g_() % Count(level))) )
+        return false;
+    state.ApplyRandomSymmetry();
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "SudokuState.h"
+#include "DifficultyRater.h"
+
+// Rated puzzles built in, each one giving millions of different looking games through ApplyRandomSymmetry,
+// so a game of any level can start straight away
+class SeedBank
+{
+public:
+    static uint8_t  Count( DifficultyBand::eLevel level );
+    static const char* Seed( DifficultyBand::eLevel level, uint8_t index );   // As stored, index below Count
+    // A random seed of the level, transformed at random
+    static bool     Draw( SudokuState& state, DifficultyBand::eLevel level );
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Utility.h"
+
+// Set to 0 to compile the SolveStats bookkeeping out, the parameters are then ignored
+#ifndef SOLVE_STATS_ENABLED
+#define SOLVE_STATS_ENABLED 1
+#endif
+
+// How much work a solve took, optionally passed to the solver and generator calls and added to
+struct SolveStats
+{
+    uint32_t    Nodes = 0;              // Search positions visited
+    uint32_t    Guesses = 0;            // Values tried in unfixed squares
+    uint32_t    Backtracks = 0;         // Guesses undone
+    uint8_t     MaxDepth = 0;
+    uint32_t    Eliminations = 0;       // Candidates removed by propagation
+    uint32_t    TimeUS = 0;             // Wall time of the outermost calls
+    uint8_t     Nesting = 0;            // Calls currently in progress, so nested ones are not timed twice
+
+    void        Visit( uint16_t depth ) { Nodes++; if( depth > MaxDepth ) MaxDepth = min<uint16_t>(depth, 255); };
+    const char* Describe( TextBuffer& text ) const;     // returns the text
+};
+
+#if SOLVE_STATS_ENABLED
+#define SOLVE_STAT(stats,expr)  do { if( stats ) { stats->expr; } } while( false )
+
+// Times the outermost solver call that was given stats
+class SolveStatsScope
+{
+protected:
+    SolveStats* Stats;
+    uint32_t    Start;
+
+public:
+    SolveStatsScope( SolveStats* stats ) : Stats(stats), Start(stats && stats->Nesting++ == 0 ? micros() : 0) {};
+    ~SolveStatsScope() { if( Stats && --Stats->Nesting == 0 ) Stats->TimeUS += micros() - Start; };
+};
+#define SOLVE_STATS_SCOPE(stats)    SolveStatsScope solveStatsScope(stats)
+#else
+#define SOLVE_STAT(stats,expr)      do {} while( false )
+#define SOLVE_STATS_SCOPE(stats)
+#endif
@@ -0,0 +1,654 @@
+#include <numeric>
+#include <random>
+#include <algorithm>
+
+#include "SudokuBoard.h"
+#include "Perf.h"
+
+extern std::mt19937 g_;
+
+const char* SolveStats::Describe( TextBuffer& text ) const
+{
+    text << Nodes << " nodes, " << Guesses << " guesses, " << Backtracks << " backtracks, depth " << MaxDepth
+        << ", " << Eliminations << " eliminations, " << TimeUS/1000 << "ms";
+    return text.c_str();
+}
+
+template <uint8_t Box, class Rules>
+void SudokuBoard<Box,Rules>::MarkFixedAsGiven()
+{
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        Givens.set(cell, Squares[cell].Fixed());
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::Propagate( SolveStats* stats )
+{
+    SOLVE_STATS_SCOPE(stats);
+    if( Solved() )
+        return false;
+    uint16_t iLoop = 0;
+    bool bAnyChangeMade = false;
+    while( PropagateOnce(iLoop++, stats) )
+        bAnyChangeMade = true;
+    return bAnyChangeMade;
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::PropagateOnce( uint16_t iLoop, SolveStats* stats )
+{
+    PERF_COUNT(ePropagatePasses);
+    bool bChangeMade = false;
+    if( !Valid() )
+    {
+//        log_d("Invalid");
+        return bChangeMade;
+    }
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+    {
+        if( !Squares[cell].Fixed() )
+            continue;
+        tdMask mask = Squares[cell].Mask();
+        const tdCell* peers = PeersOf(cell);
+        for( uint8_t i = 0 ; i < PeerCount ; i++ )
+        {
+            Square& peer = Squares[peers[i]];
+            if( peer.Fixed() || !(peer.Mask() & mask) )
+                continue;
+//            log_d("Removing %d from %d",Squares[cell].FirstPossible(),peers[i]);
+            peer.SetMask(peer.Mask() & ~mask);
+            SOLVE_STAT(stats, Eliminations++);
+            bChangeMade = true;
+            // A peer left fixed to the same value as another is caught by Valid on the next pass
+            if( !peer.Valid() ) { /*log_d("Invalid!");*/ return bChangeMade; };
+        }
+    }
+    if( Constraints.Propagate(*this, stats) )
+        bChangeMade = true;
+
+    return bChangeMade;
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::SolveByGuessing( uint8_t depth, SolveStats* stats )
+{
+    SOLVE_STATS_SCOPE(stats);
+    PERF_COUNT(eSolverNodes);
+    SOLVE_STAT(stats, Visit(maxDepth - depth));
+    if( Solved() )
+        return true;
+    // Avoid stack overflow issues
+    if( depth <= 0 )
+        return false;
+    auto point = FindLowestCountUnsolvedSquare();
+    if( point.x == -1 )
+        return false;
+    // Every level keeps the squares to go back to, which is what bounds the depth
+    ScratchArena::Mark mark(*Arena);
+    const tdSquares* oldState = Arena->New<tdSquares>(Squares);
+    if( !oldState )
+        return false;
+    Square& square = Squares[point.y*N+point.x];
+//    log_d("Attempting to fix (%d,%d)[%s]",point.x,point.y,square.AsPossibleString(possible));
+    for( uint8_t val = 1 ; val <= N ; val++ )
+    {
+        //vTaskDelay(1);
+        if( square.Possible(val) )
+        {
+//            log_d("Trying %d",val);
+            SOLVE_STAT(stats, Guesses++);
+            square.SetSolution(val);
+            Propagate(stats);
+            if( Solved() )
+                return true;
+            if( !Valid() )
+            {
+                PERF_COUNT(eBacktracks);
+                SOLVE_STAT(stats, Backtracks++);
+                Squares = *oldState;
+                continue;
+            }
+            if( SolveByGuessing(depth-1, stats) )
+                return true;
+
+            PERF_COUNT(eBacktracks);
+            SOLVE_STAT(stats, Backtracks++);
+            Squares = *oldState;
+            continue;
+        }
+    }
+    return false;
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::Valid() const
+{
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        if( !Squares[cell].Valid() )
+            return false;
+    // Each unit once, rather than every pair of peers from both ends
+    for( uint8_t unit = 0 ; unit < UnitCount ; unit++ )
+    {
+        const tdCell* cells = UnitCells(unit);
+        tdMask used = 0;
+        for( uint8_t i = 0 ; i < N ; i++ )
+        {
+            const Square& square = Squares[cells[i]];
+            if( !square.Fixed() )
+                continue;
+            if( used & square.Mask() )
+            {
+//                log_d("Invalid: unit %d has %d twice", unit, square.FirstPossible());
+                return false;
+            }
+            used |= square.Mask();
+        }
+    }
+    return Constraints.Valid(*this);
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::Solved() const
+{
+    if( !Valid() )
+        return false;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        if( !Squares[cell].Fixed() )
+            return false;
+    return true;
+}
+
+template <uint8_t Box, class Rules>
+uint16_t SudokuBoard<Box,Rules>::SumCount() const
+{
+    if( !Valid() )
+    {
+//        log_d("Invalid");
+        return 0;
+    }
+    uint32_t count = 0;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        count += Squares[cell].Count();
+    return count;
+}
+
+template <uint8_t Box, class Rules>
+Point<int8_t> SudokuBoard<Box,Rules>::FindLowestCountUnsolvedSquare() const
+{
+    if( !Valid() )
+        return {-1,-1};
+    if( Solved() )
+        return {-1,-1};
+
+    uint16_t best = 0;
+    uint8_t count = N+1;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+    {
+        //vTaskDelay(1);
+        uint8_t squareCount = Squares[cell].Count();
+        if( squareCount > 1 && squareCount < count )
+        {
+            count = squareCount;
+            best = cell;
+            if( count == 2 )
+                break;
+        }
+    }
+
+    return Point<int8_t>(best%N, best/N);
+}
+
+template <uint8_t Box, class Rules>
+uint16_t SudokuBoard<Box,Rules>::CountFixed() const
+{
+    uint16_t count = 0;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        if( Squares[cell].Fixed() )
+            count++;
+    return count;
+}
+
+template <uint8_t Box, class Rules>
+void SudokuBoard<Box,Rules>::Dump() const
+{
+    for( uint8_t y = 0 ; y < N ; y++ )
+    {
+        TextBuffer str;
+        for( uint8_t x = 0 ; x < N ; x++ )
+        {
+            const Square& square = Squares[y*N+x];
+            if( square.Fixed() )
+            {
+                uint8_t val = square.FirstPossible();
+                str << (val <= 9 ? (char)('0' + val) : (char)('A' + val - 10));
+            }
+            else if( square.Valid() )
+            {
+                const char c = ('a' + square.Count() - 2);
+                str << c;
+            }
+            else
+                str << "!";
+        }
+        log_d("%s",str.c_str());
+    }
+};
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::EnsureSolution()
+{
+    if( HasSolution() )
+        return true;
+
+    // Games from before givens were recorded can only use what is filled in
+    bool useFixed = CountGivens() == 0;
+    ScratchArena::Mark mark(*Arena);
+    SudokuBoard* copy = Arena->New<SudokuBoard>(*this);
+    if( !copy )
+        return false;
+    SudokuBoard& temp = *copy;
+    temp.GenerateEmpty();
+    temp.CancelFlag = nullptr;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        if( useFixed ? Squares[cell].Fixed() : Givens[cell] )
+            temp.Squares[cell] = Squares[cell];
+    if( !temp.Valid() )
+        return false;
+    temp.Propagate();
+    // Without a unique solution the answer is left unknown, and the board is checked as it stands
+    if( temp.SolveUniquely() != 1 )
+        return false;
+    temp.SolveByGuessing();
+    if( !temp.Solved() || !temp.Valid() )
+        return false;
+
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        Solution[cell] = temp.Squares[cell].FirstPossible();
+    return true;
+}
+
+template <uint8_t Box, class Rules>
+typename SudokuBoard<Box,Rules>::tdCellSet SudokuBoard<Box,Rules>::FindMistakes() const
+{
+    tdCellSet mistakes;
+    if( !HasSolution() )
+        return mistakes;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        if( !(Squares[cell].Mask() & Square::Bit(Solution[cell])) )
+            mistakes.set(cell);
+    return mistakes;
+}
+
+template <uint8_t Box, class Rules>
+typename SudokuBoard<Box,Rules>::tdCellSet SudokuBoard<Box,Rules>::ChangedSquares( const SudokuBoard& other ) const
+{
+    tdCellSet changed;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        if( Squares[cell].Mask() != other.Squares[cell].Mask() )
+            changed.set(cell);
+    return changed;
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::FindLogicalStep( Point<uint8_t>& square, uint8_t& value ) const
+{
+    // Only one value can go in a square
+    for( uint8_t y = 0 ; y < N ; y++ )
+        for( uint8_t x = 0 ; x < N ; x++ )
+        {
+            if( Squares[y*N+x].Fixed() )
+                continue;
+            uint8_t count = 0;
+            for( uint8_t val = 1 ; val <= N && count < 2 ; val++ )
+                if( CheckPossible(x,y,val) )
+                {
+                    count++;
+                    value = val;
+                }
+            if( count == 1 )
+            {
+                square = Point<uint8_t>(x,y);
+                return true;
+            }
+        }
+
+    // A value can only go in one square of a row, column or block
+    for( uint8_t unit = 0 ; unit < UnitCount ; unit++ )
+    {
+        const tdCell* cells = UnitCells(unit);
+        for( uint8_t val = 1 ; val <= N ; val++ )
+        {
+            uint8_t count = 0;
+            bool placed = false;
+            for( uint8_t i = 0 ; i < N && !placed ; i++ )
+            {
+                const Square& thisSquare = Squares[cells[i]];
+                if( thisSquare.Fixed() )
+                    placed = thisSquare.FirstPossible() == val;
+                else if( CheckPossible(cells[i]%N,cells[i]/N,val) )
+                {
+                    count++;
+                    square = Point<uint8_t>(cells[i]%N,cells[i]/N);
+                }
+            }
+            if( !placed && count == 1 )
+            {
+                value = val;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+template <uint8_t Box, class Rules>
+Point<int8_t> SudokuBoard<Box,Rules>::FixOneSquare( eHint hint )
+{
+    if( Solved() || !EnsureSolution() )
+        return {-1,-1};
+
+    // A deduction from a wrong entry is no help, so it must agree with the solution
+    Point<uint8_t> square;
+    uint8_t value = 0;
+    if( hint == eHintLogical && FindLogicalStep(square,value) && Solution[square.y*N+square.x] == value )
+    {
+        Squares[square.y*N+square.x].SetSolution(value);
+        return Point<int8_t>(square.x,square.y);
+    }
+
+    tdCell unfilled[CellCount];
+    uint16_t count = 0;
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        if( !Squares[cell].Fixed() )
+            unfilled[count++] = cell;
+    if( count == 0 )
+        return {-1,-1};
+
+    tdCell cell = unfilled[random(0,count)];
+    Squares[cell].SetSolution(Solution[cell]);
+    return Point<int8_t>(cell%N,cell/N);
+}
+
+template <uint8_t Box, class Rules>
+void SudokuBoard<Box,Rules>::GenerateSolved( SolveStats* stats )
+{
+    SOLVE_STATS_SCOPE(stats);
+    // The blocks down the diagonal share no rows or columns so can be filled in freely, the search then completes the grid.
+    // Added rules may cross blocks, so then only the first is filled in.
+    std::array<uint8_t,N> values;
+    std::iota(values.begin(), values.end(), 1);
+    do
+    {
+        GenerateEmpty();
+        for( uint8_t block = 0 ; block < (Rules::Active ? 1 : Box) ; block++ )
+        {
+            std::shuffle(values.begin(), values.end(), g_);
+            const tdCell* cells = UnitCells(2*N + block*Box + block);
+            for( uint8_t i = 0 ; i < N ; i++ )
+                Squares[cells[i]].SetSolution(values[i]);
+        }
+    } while( !FillFirstSolution(stats) );
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        Solution[cell] = Squares[cell].FirstPossible();
+}
+
+template <uint8_t Box, class Rules>
+void SudokuBoard<Box,Rules>::GenerateRandom( uint16_t targetFixedCells, uint32_t targetSolveTimeMS, SolveStats* stats )
+{
+    SOLVE_STATS_SCOPE(stats);
+    auto ts = millis();
+    log_d("Starting GenerateRandom at %d", ts);
+
+    std::array<tdCell,CellCount> order;
+    std::iota(order.begin(), order.end(), 0);
+
+    // Out of scratch the board is left as it was, with the arena marked overflowed
+    ScratchArena::Mark mark(*Arena);
+    SudokuBoard* boards[3];
+    for( SudokuBoard*& board : boards )
+        if( !(board = Arena->New<SudokuBoard>(*this)) )
+            return;
+    SudokuBoard& current = *boards[0];
+    current.GenerateSolved(stats);
+    log_d("Solved state (%c,%c) in %d",current.Valid()?'Y':'N',current.Solved()?'Y':'N',millis()-ts);
+    current.Dump();
+
+    uint16_t outerloop = 0;
+    SudokuBoard& solved = *boards[1];
+    SudokuBoard& lastResult = *boards[2];
+    solved = current;
+    lastResult = solved;
+    uint16_t bestCount = CellCount+1;
+    while( true && outerloop++ < 100 && millis() - ts < targetSolveTimeMS )
+    {
+        std::shuffle(order.begin(), order.end(), g_);
+        current = solved;
+        log_d("Current has %d fixed squares", current.CountFixed());
+        for( tdCell square : order )
+        {
+            //vTaskDelay(1);
+            if( current.CountFixed() <= targetFixedCells )
+                break;
+
+            if( !current.Squares[square].Fixed() )
+                continue;
+            // Checking for a unique solution leaves the squares alone, so the clue is only put back if it is needed
+            Square removed = current.Squares[square];
+            current.Squares[square] = Square();
+            uint8_t result = current.SolveUniquely(stats);
+            if( result == 1 )
+                log_d("Cleared (%d,%d), still solveable, count fixed %d",square%N,square/N,current.CountFixed());
+            else
+            {
+                current.Squares[square] = removed;
+                log_d("Removal failed, result = %d, count fixed %d", result, current.CountFixed());
+            }
+        }
+        uint16_t thisCount = current.CountFixed();
+        if( thisCount < bestCount )
+        {
+            log_d("New best %d",thisCount);
+            lastResult = current;
+            bestCount = thisCount;
+            if( bestCount <= targetFixedCells )
+                break;
+        }
+    }
+    current = lastResult;
+    log_d("Complete (%c,%d fixed squares), total time %d", current.Valid()?'Y':'N', current.CountFixed(), millis()-ts);
+    TextBuffer text;
+    if( stats )
+        log_d("Generate: %s", stats->Describe(text));
+    if( current.Valid() )
+        (*this) = current;
+    else
+        (*this) = solved;
+    MarkFixedAsGiven();
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+        Solution[cell] = solved.Squares[cell].FirstPossible();
+}
+
+// Values placed in each unit, and the cells still to fill, updated as the search goes down and back up
+template <uint8_t Box, class Rules>
+struct SudokuBoard<Box,Rules>::SearchState
+{
+    tdMask      Used[UnitCount];
+    tdCell      Empty[CellCount];       // The first EmptyCount are unfilled
+    uint16_t    EmptyCount = 0;
+    uint8_t     Values[CellCount];      // Placed so far, only kept when filling in
+    bool        Fill = false;           // Stop at the first solution and put it in the squares
+    typename Rules::Search Extra;
+};
+
+template <uint8_t Box, class Rules>
+uint8_t SudokuBoard<Box,Rules>::SolveUniquely( SolveStats* stats )
+{
+    SOLVE_STATS_SCOPE(stats);
+    PERF_COUNT(eUniquenessCalls);
+    ScratchArena::Mark mark(*Arena);
+    SearchState* search = Arena->New<SearchState>();
+    return search ? StartSearch(*search, stats) : 0;
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::FillFirstSolution( SolveStats* stats )
+{
+    SOLVE_STATS_SCOPE(stats);
+    ScratchArena::Mark mark(*Arena);
+    SearchState* search = Arena->New<SearchState>();
+    if( !search )
+        return false;
+    search->Fill = true;
+    return StartSearch(*search, stats) == 1;
+}
+
+template <uint8_t Box, class Rules>
+uint8_t SudokuBoard<Box,Rules>::StartSearch( SearchState& search, SolveStats* stats )
+{
+    if( !Valid() )
+        return 0;
+
+    std::fill(search.Used, search.Used + UnitCount, 0);
+    for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+    {
+        const Square& square = Squares[cell];
+        if( !square.Fixed() )
+        {
+            search.Empty[search.EmptyCount++] = cell;
+            continue;
+        }
+        const uint8_t* units = Geometry::CellUnits + cell*3;
+        for( uint8_t i = 0 ; i < 3 ; i++ )
+            search.Used[units[i]] |= square.Mask();
+    }
+    search.Extra.Init(Constraints, *this);
+    return CountSolutions(search, 0, 0, stats);
+}
+
+template <uint8_t Box, class Rules>
+uint8_t SudokuBoard<Box,Rules>::CountSolutions( SearchState& search, uint16_t depth, uint8_t count, SolveStats* stats )
+{
+    PERF_COUNT(eSolverNodes);
+    SOLVE_STAT(stats, Visit(depth));
+    if( CancelFlag && *CancelFlag )
+        return count;
+    if( search.EmptyCount == 0 )
+    {
+        if( search.Fill )
+            for( uint16_t cell = 0 ; cell < CellCount ; cell++ )
+                if( !Squares[cell].Fixed() )
+                    Squares[cell].SetSolution(search.Values[cell]);
+        return count+1;
+    }
+
+    // The cell with fewest values left, so dead ends are found as early as possible
+    uint16_t best = 0;
+    tdMask bestMask = 0;
+    uint8_t bestCount = N+1;
+    for( uint16_t i = 0 ; i < search.EmptyCount && bestCount > 1 ; i++ )
+    {
+        const uint8_t* units = Geometry::CellUnits + search.Empty[i]*3;
+        tdMask mask = search.Extra.Allowed(search.Empty[i]) & ~(search.Used[units[0]] | search.Used[units[1]] | search.Used[units[2]]);
+        uint8_t bits = Square::CountBits(mask);
+        if( bits == 0 )
+            return count;
+        if( bits < bestCount )
+        {
+            best = i;
+            bestMask = mask;
+            bestCount = bits;
+        }
+    }
+
+    // Out of the list while it is being tried, the cells after it get shuffled but stay the same set
+    tdCell cell = search.Empty[best];
+    search.Empty[best] = search.Empty[--search.EmptyCount];
+    search.Empty[search.EmptyCount] = cell;
+    const uint8_t* units = Geometry::CellUnits + cell*3;
+    while( bestMask && count < (search.Fill ? 1 : 2) )
+    {
+        tdMask bit = bestMask & (tdMask)(~bestMask + 1);
+        bestMask &= ~bit;
+        uint8_t val = Square::CountBits(bit - 1) + 1;
+        search.Values[cell] = val;
+        SOLVE_STAT(stats, Guesses++);
+        for( uint8_t i = 0 ; i < 3 ; i++ )
+            search.Used[units[i]] |= bit;
+        search.Extra.Place(cell, val);
+        uint8_t before = count;
+        count = CountSolutions(search, depth+1, count, stats);
+        search.Extra.Unplace(cell, val);
+        for( uint8_t i = 0 ; i < 3 ; i++ )
+            search.Used[units[i]] &= ~bit;
+        // A dead end, rather than a branch that found a solution
+        if( count == before )
+        {
+            PERF_COUNT(eBacktracks);
+            SOLVE_STAT(stats, Backtracks++);
+        }
+    }
+    search.EmptyCount++;
+    return count;
+}
+
+template <uint8_t Box, class Rules>
+bool SudokuBoard<Box,Rules>::CheckPossible(uint8_t x, uint8_t y, uint8_t val) const
+{
+    tdMask fixedMask = Square::Bit(val);
+    const tdCell* peers = PeersOf(y*N+x);
+    for( uint8_t i = 0 ; i < PeerCount ; i++ )
+        if( Squares[peers[i]].Mask() == fixedMask )
+            return false;
+    return Constraints.Possible(*this, y*N+x, val);
+}
+
+template <uint8_t Box, class Rules>
+typename SudokuBoard<Box,Rules>::tdMask SudokuBoard<Box,Rules>::PossibleMask( uint8_t x, uint8_t y ) const
+{
+    tdMask mask = 0;
+    for( uint8_t val = 1 ; val <= N ; val++ )
+        if( CheckPossible(x,y,val) )
+            mask |= Square::Bit(val);
+    return mask;
+}
+
+template <uint8_t Box, class Rules>
+typename SudokuBoard<Box,Rules>::tdCellSet SudokuBoard<Box,Rules>::UpdatePeerCandidates( uint8_t x, uint8_t y, const Square& before )
+{
+    tdCellSet changed;
+    const Square now = Squares[y*N+x];
+    uint8_t removed = before.Fixed() ? before.FirstPossible() : 0;
+    uint8_t placed = now.Fixed() ? now.FirstPossible() : 0;
+    if( removed == placed )
+        return changed;
+
+    const tdCell* peers = PeersOf(y*N+x);
+    for( uint8_t i = 0 ; i < PeerCount ; i++ )
+    {
+        tdCell peer = peers[i];
+        uint8_t px = peer%N;
+        uint8_t py = peer/N;
+        Square& other = Squares[peer];
+        if( other.Fixed() )
+            continue;
+        // Values that could go in the peer before this change but are not marked were taken out by the player
+        Squares[y*N+x] = before;
+        tdMask userRemoved = PossibleMask(px,py) & ~other.Mask();
+        Squares[y*N+x] = now;
+        tdMask mask = PossibleMask(px,py) & ~userRemoved;
+        // Nothing left means a mistake somewhere, which the marks should not hide
+        if( mask == 0 || mask == other.Mask() )
+            continue;
+        other.SetMask(mask);
+        changed.set(peer);
+    }
+    return changed;
+}
+
+// 4x4 and 16x16 as well as the game itself, the tables for 25x25 are too big to carry around unused
+template class SudokuBoard<2>;
+template class SudokuBoard<3>;
+template class SudokuBoard<4>;
+template class SudokuBoard<3,DiagonalRules<3>>;
+template class SudokuBoard<3,WindokuRules<3>>;
+template class SudokuBoard<3,KillerRules<3>>;
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <Arduino.h>
+#include <array>
+#include <atomic>
+#include <bitset>
+
+#include "Utility.h"
+#include "ScratchArena.h"
+#include "SudokuSquare.h"
+#include "SolveStats.h"
+#include "SudokuVariants.h"
+
+// Compile time tables, built by expanding an index pack over every entry
+namespace SudokuTables
+{
+    template <uint16_t... I> struct Indices {};
+
+    // Split in halves, so 25x25 tables stay well inside the template depth limit
+    template <class A, class B> struct Concat;
+    template <uint16_t... A, uint16_t... B> struct Concat<Indices<A...>,Indices<B...>> { using type = Indices<A..., (sizeof...(A) + B)...>; };
+    template <uint16_t N> struct MakeIndices { using type = typename Concat<typename MakeIndices<N/2>::type, typename MakeIndices<N - N/2>::type>::type; };
+    template <> struct MakeIndices<0> { using type = Indices<>; };
+    template <> struct MakeIndices<1> { using type = Indices<0>; };
+
+    template <class T, uint16_t Size> struct Table
+    {
+        T           Data[Size];
+        const T*    operator+( uint16_t offset ) const { return Data + offset; };
+        const T&    operator[]( uint16_t i ) const { return Data[i]; };
+    };
+}
+
+// The shape of a board made of Box x Box blocks, N = Box*Box values, with cells numbered y*N+x
+template <uint8_t Box>
+struct BoardShape
+{
+    static_assert(Box >= 2 && Box <= 5, "Boards from 4x4 to 25x25");
+
+    static constexpr uint8_t    N = Box*Box;
+    static constexpr uint16_t   CellCount = N*N;
+    static constexpr uint8_t    UnitCount = 3*N;                            // Rows, then columns, then blocks
+    static constexpr uint8_t    PeerCount = 2*(N-1) + (Box-1)*(Box-1);      // 20 for 9x9
+    using tdCell = typename std::conditional<(CellCount <= 256), uint8_t, uint16_t>::type;
+
+protected:
+    static constexpr uint8_t    Skip( uint8_t i, uint8_t skip ) { return i < skip ? i : i+1; };
+
+    // Row peers, then column peers, then the rest of the block
+    static constexpr tdCell     Peer( uint16_t cell, uint8_t i )
+    {
+        return i < N-1      ? cell/N*N + Skip(i, cell%N)
+            : i < 2*(N-1)   ? Skip(i-(N-1), cell/N)*N + cell%N
+            : (cell/N/Box*Box + Skip((i-2*(N-1))/(Box-1), cell/N%Box))*N + cell%N/Box*Box + Skip((i-2*(N-1))%(Box-1), cell%N%Box);
+    }
+    static constexpr tdCell     UnitCell( uint8_t unit, uint8_t i )
+    {
+        return unit < N     ? unit*N + i
+            : unit < 2*N    ? i*N + (unit-N)
+            : ((unit-2*N)/Box*Box + i/Box)*N + (unit-2*N)%Box*Box + i%Box;
+    }
+    static constexpr uint8_t    CellUnit( uint16_t cell, uint8_t i )
+    {
+        return i == 0 ? cell/N : i == 1 ? N + cell%N : 2*N + cell/N/Box*Box + cell%N/Box;
+    }
+
+    template <uint16_t... I> static constexpr SudokuTables::Table<tdCell,sizeof...(I)> MakePeers( SudokuTables::Indices<I...> ) { return {{ Peer(I/PeerCount, I%PeerCount)... }}; };
+    template <uint16_t... I> static constexpr SudokuTables::Table<tdCell,sizeof...(I)> MakeUnits( SudokuTables::Indices<I...> ) { return {{ UnitCell(I/N, I%N)... }}; };
+    template <uint16_t... I> static constexpr SudokuTables::Table<uint8_t,sizeof...(I)> MakeCellUnits( SudokuTables::Indices<I...> ) { return {{ CellUnit(I/3, I%3)... }}; };
+};
+
+// The tables have to be in a class of their own, BoardShape's functions cannot be used until it is complete
+template <uint8_t Box>
+struct BoardGeometry : public BoardShape<Box>
+{
+    using Shape = BoardShape<Box>;
+    using Shape::N;
+    using Shape::CellCount;
+    using Shape::UnitCount;
+    using Shape::PeerCount;
+    using typename Shape::tdCell;
+
+    // PeerCount per cell, N per unit, 3 per cell
+    static constexpr SudokuTables::Table<tdCell,CellCount*PeerCount>  Peers = Shape::MakePeers(typename SudokuTables::MakeIndices<CellCount*PeerCount>::type());
+    static constexpr SudokuTables::Table<tdCell,UnitCount*N>          Units = Shape::MakeUnits(typename SudokuTables::MakeIndices<UnitCount*N>::type());
+    static constexpr SudokuTables::Table<uint8_t,CellCount*3>         CellUnits = Shape::MakeCellUnits(typename SudokuTables::MakeIndices<CellCount*3>::type());
+};
+
+template <uint8_t Box> constexpr SudokuTables::Table<typename BoardGeometry<Box>::tdCell,BoardGeometry<Box>::CellCount*BoardGeometry<Box>::PeerCount> BoardGeometry<Box>::Peers;
+template <uint8_t Box> constexpr SudokuTables::Table<typename BoardGeometry<Box>::tdCell,BoardGeometry<Box>::UnitCount*BoardGeometry<Box>::N> BoardGeometry<Box>::Units;
+template <uint8_t Box> constexpr SudokuTables::Table<uint8_t,BoardGeometry<Box>::CellCount*3> BoardGeometry<Box>::CellUnits;
+
+// The squares of a board, with the solver and generator, for any block size and set of rules.
+// Box 3 with the classic rules is the game, SudokuState adds saving and loading to that.
+template <uint8_t Box, class Rules = ClassicRules<Box>>
+class SudokuBoard : public BoardGeometry<Box>
+{
+public:
+    using Geometry = BoardGeometry<Box>;
+    using Geometry::N;
+    using Geometry::CellCount;
+    using Geometry::UnitCount;
+    using Geometry::PeerCount;
+    using typename Geometry::tdCell;
+    using Square = BasicSudokuSquare<N>;
+    using tdMask = typename Square::tdMask;
+    using tdCellSet = std::bitset<CellCount>;
+
+    SudokuBoard() = default;
+
+protected:
+    using tdSquares = std::array<Square,CellCount>;
+    tdSquares       Squares;                    // Cells y*N+x, as everything else
+    tdCellSet       Givens;                     // Cells that were part of the puzzle
+    std::array<uint8_t,CellCount> Solution{};   // 0 if the solution is not known
+    constexpr static uint8_t maxDepth = 64;
+    // SolveByGuessing keeps the squares at every level, which must fit with room for the rest of a job
+    static_assert(maxDepth * sizeof(tdSquares) < ScratchArena::DefaultSize, "The deepest guess does not fit in the scratch arena");
+    const std::atomic<bool>* CancelFlag = nullptr;   // SolveUniquely gives up when set
+    ScratchArena*   Arena = &Scratch;           // Working boards and search state, copies share it
+    Rules           Constraints;                // Any beyond rows, columns and blocks
+
+    struct SearchState;
+    uint8_t         StartSearch( SearchState& search, SolveStats* stats );
+    uint8_t         CountSolutions( SearchState& search, uint16_t depth, uint8_t count, SolveStats* stats );
+    bool            FillFirstSolution( SolveStats* stats );     // Completes the squares with the first solution found
+
+public:
+    static const tdCell* PeersOf( uint16_t cell ) { return Geometry::Peers + cell*PeerCount; };
+    static const tdCell* UnitCells( uint8_t unit ) { return Geometry::Units + unit*N; };
+    Rules&          GetConstraints() { return Constraints; };
+    const Rules&    GetConstraints() const { return Constraints; };
+
+    void            GenerateEmpty() { Squares.fill(Square()); Givens.reset(); Solution.fill(0); };
+    void            GenerateRandom( uint16_t targetFixedCells, uint32_t targetSolveTimeMS, SolveStats* stats = nullptr );
+    void            GenerateSolved( SolveStats* stats = nullptr );     // A random complete grid, which is also the solution
+
+    bool            Propagate( SolveStats* stats = nullptr );        // returns true if any changes were made
+    bool            PropagateOnce( uint16_t iLoop = 0, SolveStats* stats = nullptr ); // returns true if a change was made
+    bool            SolveByGuessing( uint8_t depth = maxDepth, SolveStats* stats = nullptr );  // returns true if solved
+    void            SetCancelFlag( const std::atomic<bool>* cancel ) { CancelFlag = cancel; };
+    void            SetArena( ScratchArena* arena ) { Arena = arena; };
+    ScratchArena&   GetArena() const { return *Arena; };
+    // Counts the ways the squares without a single value can be filled in, ignoring the possible values marked
+    // in them. Returns 0 if unsolved, 1 if unique solution found or 2 if more than one solution found.
+    // Also 0 if the arena has no room for the search, which leaves it marked overflowed.
+    uint8_t         SolveUniquely( SolveStats* stats = nullptr );
+
+    bool            Valid() const;
+    bool            Solved() const;
+    uint16_t        SumCount() const;
+    uint16_t        CountFixed() const;
+    bool            CheckPossible(uint8_t x, uint8_t y, uint8_t val) const;
+    tdMask          PossibleMask( uint8_t x, uint8_t y ) const;     // Bit of each value CheckPossible allows
+
+    Point<int8_t>   FindLowestCountUnsolvedSquare() const;
+
+    enum eHint : uint8_t {
+        eHintReveal,        // A random unfilled square
+        eHintLogical,       // The next naked or hidden single, if there is one, otherwise as eHintReveal
+    };
+    // Fills in one square from the solution, returns it or {-1,-1}
+    Point<int8_t>   FixOneSquare( eHint hint = eHintReveal );
+    bool            FindLogicalStep( Point<uint8_t>& square, uint8_t& value ) const;   // returns false if there is no single
+
+    Square&         GetSquare( Point<uint8_t> pt ) { return GetSquare(pt.x,pt.y); };
+    Square&         GetSquare( uint8_t x, uint8_t y ) { return Squares[y*N+x]; };
+    const Square&   GetSquare( uint8_t x, uint8_t y ) const { return Squares[y*N+x]; };
+    Square&         GetCell( uint16_t cell ) { return Squares[cell]; };
+    const Square&   GetCell( uint16_t cell ) const { return Squares[cell]; };
+
+    bool            IsGiven( uint8_t x, uint8_t y ) const { return Givens[y*N+x]; };
+    uint16_t        CountGivens() const { return Givens.count(); };
+    void            MarkFixedAsGiven();
+    bool            HasSolution() const { return Solution[0] != 0; };
+    bool            EnsureSolution();   // Solves from the givens if needed, returns false if there is no unique solution
+    // A value that is wrong, or possible values that rule out the right one
+    bool            IsMistake( uint8_t x, uint8_t y ) const { return HasSolution() && !(Squares[y*N+x].Mask() & Square::Bit(Solution[y*N+x])); };
+    tdCellSet       FindMistakes() const;   // None if the solution is not known
+    tdCellSet       ChangedSquares( const SudokuBoard& other ) const;
+
+    // After the square at x,y changed from before, in auto marks mode: every peer that is not fixed,
+    // empty ones included, is marked with the values its own peers allow, less any the player had taken
+    // out by hand. A peer left with one value counts as placed. Returns the peers changed.
+    tdCellSet       UpdatePeerCandidates( uint8_t x, uint8_t y, const Square& before );
+
+    void            Dump() const;
+};
@@ -1,44 +1,63 @@
 #pragma once
 
-#include <bitset>
+#include <stdint.h>
+#include <type_traits>
 
-class SudokuSquare
+// Smallest unsigned type with a bit per value
+template <uint8_t N> struct SquareMaskType
+{
+    using type = typename std::conditional<(N <= 16), uint16_t,
+                 typename std::conditional<(N <= 32), uint32_t, uint64_t>::type>::type;
+};
+
+// The possible values 1..N for one square, a single possible value means the square is filled in
+template <uint8_t N>
+class BasicSudokuSquare
 {
 public:
-    SudokuSquare() : BitSet(511) {};    // Set first 9 bits
+    using tdMask = typename SquareMaskType<N>::type;
+    static constexpr tdMask AllMask = (tdMask)(((uint64_t)1 << N) - 1);
+
+    BasicSudokuSquare() : Bits(AllMask) {};
 
 protected:
-    std::bitset<9>  BitSet;             // Possible values for square
+    tdMask          Bits;               // Bit i-1 set if i is possible
 
 public:
-    uint8_t         Count() const { return BitSet.count(); };
-    bool            Valid() const { return Count() > 0; };
-    bool            Fixed() const { return Count() == 1; };
-
-    bool            Possible( uint8_t i ) const { if( i > 0 && i <= 9 ) return BitSet[i-1]; else return false; };
-    void            RemovePossible( uint8_t i ) { if( i > 0 && i <= 9 ) BitSet.reset(i-1); };
-    void            AddPossible( uint8_t i ) { if( i > 0 && i <= 9 ) BitSet.set(i-1); };
-    void            SetSolution( uint8_t i ) { BitSet.reset(); if( i > 0 && i <= 9 ) BitSet.set(i-1); };
-    
-    uint8_t         FirstPossible() const { for( uint8_t i = 0 ; i < 9 ; i++ ) if( BitSet[i] ) return i+1; return 255; };
-
-    SudokuSquare    IdentifyUniques( const SudokuSquare& other ) const
+    static uint8_t  CountBits( tdMask mask ) { return sizeof(tdMask) > 4 ? __builtin_popcountll(mask) : __builtin_popcount(mask); };
+    static tdMask   Bit( uint8_t i ) { return (tdMask)1 << (i-1); };
+
+    uint8_t         Count() const { return CountBits(Bits); };
+    bool            Valid() const { return Bits != 0; };
+    bool            Fixed() const { return Bits != 0 && (Bits & (Bits-1)) == 0; };
+
+    bool            Possible( uint8_t i ) const { if( i > 0 && i <= N ) return Bits & Bit(i); else return false; };
+    void            RemovePossible( uint8_t i ) { if( i > 0 && i <= N ) Bits &= ~Bit(i); };
+    void            AddPossible( uint8_t i ) { if( i > 0 && i <= N ) Bits |= Bit(i); };
+    void            SetSolution( uint8_t i ) { Bits = i > 0 && i <= N ? Bit(i) : 0; };
+
+    tdMask          Mask() const { return Bits; };
+    void            SetMask( tdMask mask ) { Bits = mask & AllMask; };
+
+    uint8_t         FirstPossible() const { return Bits ? (sizeof(tdMask) > 4 ? __builtin_ctzll(Bits) : __builtin_ctz(Bits)) + 1 : 255; };
+
+    BasicSudokuSquare IdentifyUniques( const BasicSudokuSquare& other ) const
     {
-        SudokuSquare ret = (*this);
-        for( uint8_t i = 1 ; i <= 9 ; i++ )
-            if( other.Possible(i) )
-                ret.RemovePossible(i);
+        BasicSudokuSquare ret = (*this);
+        ret.Bits &= ~other.Bits;
         return ret;
     }
 
-    String          AsPossibleString() const 
+    // buffer needs room for N+1 characters
+    const char*     AsPossibleString( char* buffer ) const
     {
-        String ret = "";
-        for( uint8_t i = 1 ; i <= 9 ; i++ )
-            if( Possible(i) )
-                ret += String(i);
-            else
-                ret += "_";
-        return ret;
+        for( uint8_t i = 1 ; i <= N ; i++ )
+            buffer[i-1] = !Possible(i) ? '_' : i <= 9 ? '0' + i : 'A' + i - 10;
+        buffer[N] = 0;
+        return buffer;
     }
 };
+
+template <uint8_t N> constexpr typename BasicSudokuSquare<N>::tdMask BasicSudokuSquare<N>::AllMask;
+
+using SudokuSquare = BasicSudokuSquare<9>;
@@ -1,49 +1,47 @@
 #pragma once
 
 #include <Arduino.h>
-#include <array>
 
-#include "SudokuSquare.h"
+#include "Utility.h"
+#include "SudokuBoard.h"
 
-class SudokuState
+// Everything needed to restore a game, stored as a single NVS blob
+struct __attribute__((packed)) SudokuSaveBlob
+{
+    static constexpr uint8_t CurrentVersion = 1;
+    enum eFlags : uint8_t {
+        eHasSolution = 1 << 0,
+    };
+
+    uint8_t     Version = CurrentVersion;
+    uint8_t     Flags = 0;
+    uint16_t    Candidates[81];     // Cell y*9+x, bit i set if i+1 is possible
+    uint8_t     Givens[11];         // Bit per cell
+    uint8_t     Solution[41];       // Nibble per cell, low nibble first
+    uint32_t    Crc = 0;            // Of everything above
+
+    uint32_t    CalculateCrc() const { return Crc32(this, offsetof(SudokuSaveBlob,Crc)); };
+};
+
+class SudokuState : public SudokuBoard<3>
 {
 public:
     SudokuState() = default;
 
-protected:
-    using tdSquares = std::array<std::array<SudokuSquare,9>,9>;
-    tdSquares       Squares;
-    constexpr static uint8_t maxDepth = 64;
-    static bool     hasSave;
-
-public:
-    void            GenerateEmpty() { for( uint8_t x = 0 ; x < 9 ; x++ ) for( uint8_t y = 0 ; y < 9 ; y++ ) Squares[x][y] = SudokuSquare(); };
     void            GenerateFromString( String str );
-    void            GenerateRandom( uint8_t targetFixedCells, uint32_t targetSolveTimeMS );
-
-    bool            Propagate();        // returns true if any changes were made
-    bool            PropagateOnce( uint16_t iLoop = 0 ); // returns true if a change was made
-    bool            SolveByGuessing( uint8_t depth = maxDepth );  // returns true if solved
-    uint8_t         SolveUniquely( uint8_t depth = maxDepth, uint8_t x = 0, uint8_t y = 0, uint8_t count = 0 );  // returns 0 if unsolved, 1 if unique solution found or 2 if more than one solution found
-
-    bool            Valid() const;
-    bool            Solved() const;
-    uint16_t        SumCount() const;
-    uint8_t         CountFixed() const;
-    bool            CheckPossible(uint8_t x, uint8_t y, uint8_t val) const;
-
-    Point<int8_t>  FindLowestCountUnsolvedSquare() const;
-    void            FixOneSquare();
-
-    SudokuSquare&   GetSquare( Point<uint8_t> pt ) { return GetSquare(pt.x,pt.y); };
-    SudokuSquare&   GetSquare( uint8_t x, uint8_t y ) { return Squares[x][y]; };
-
-    void            Load();
+    // 81 characters, with '.', '0' or ' ' for an empty square. Returns false if it is not a solvable puzzle.
+    bool            GenerateFromText( const char* text );
+    // Transposes, reorders the bands, the rows within them, the stacks and the columns within them, and relabels
+    // the values, all at random. Solutions and difficulty are unchanged, marks and the solution go with their squares.
+    void            ApplyRandomSymmetry();
+    // Of the puzzle's smallest form, the same for puzzles that only differ by symmetry or relabelling
+    uint64_t        CanonicalHash() const;
+
+    void            ToBlob( SudokuSaveBlob& blob ) const;
+    bool            FromBlob( const SudokuSaveBlob& blob );     // returns false if the blob is not valid
+
+    // Into and out of the current save slot
+    bool            Load();     // returns false if there is no saved game
     void            Save();
-    static void     RemoveSave();
-    static bool     HasSave() { return hasSave; };
-    static bool     CheckHasSave();
-
-    void            Dump() const;
-
+    static bool     LoadLegacy( SudokuState& state );   // From the 27 key format, removing it
 };
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+#include <type_traits>
+
+#include "SudokuSquare.h"
+#include "SolveStats.h"
+
+// Rules added to the rows, columns and blocks, given as SudokuBoard's Rules parameter.
+// Calls to them are resolved at compile time, so the classic rules cost nothing in the solver.
+// A set of rules provides:
+//   Active                         false if it adds nothing
+//   Valid(board)                   the filled in squares break none of the added rules
+//   Possible(board,cell,val)       val at cell breaks none of the added rules
+//   Propagate(board,stats)         removes the values the added rules rule out, returns true if any were
+//   Search                         kept up to date by SolveUniquely as it places values, with
+//                                  Init(rules,board), Allowed(cell), Place(cell,val) and Unplace(cell,val)
+template <uint8_t Box>
+struct ClassicRules
+{
+    static constexpr uint8_t N = Box*Box;
+    using tdMask = typename BasicSudokuSquare<N>::tdMask;
+    static constexpr bool Active = false;
+
+    template <class Board> bool Valid( const Board& ) const { return true; };
+    template <class Board> bool Possible( const Board&, uint16_t, uint8_t ) const { return true; };
+    template <class Board> bool Propagate( Board&, SolveStats* ) const { return false; };
+
+    struct Search
+    {
+        template <class Board> void Init( const ClassicRules&, const Board& ) {};
+        tdMask      Allowed( uint16_t ) const { return BasicSudokuSquare<N>::AllMask; };
+        void        Place( uint16_t, uint8_t ) {};
+        void        Unplace( uint16_t, uint8_t ) {};
+    };
+};
+
+// Extra groups of cells whose values must all differ, each cell in at most two of them.
+// Derived can narrow the values a group allows with GroupAllowed, and check a full group with GroupComplete.
+template <uint8_t Box, uint16_t MaxGroups, class Derived>
+class GroupRules
+{
+public:
+    static constexpr uint8_t    N = Box*Box;
+    static constexpr uint16_t   CellCount = N*N;
+    static constexpr uint16_t   NoGroup = 0xFFFF;
+    static constexpr bool       Active = true;
+    using Square = BasicSudokuSquare<N>;
+    using tdMask = typename Square::tdMask;
+    using tdCell = typename std::conditional<(CellCount <= 256), uint8_t, uint16_t>::type;
+
+    GroupRules() { memset(CellGroups, 0xFF, sizeof(CellGroups)); };
+
+protected:
+    tdCell      Cells[MaxGroups][N];
+    uint8_t     Sizes[MaxGroups] = {};
+    uint16_t    GroupCount = 0;
+    uint16_t    CellGroups[CellCount][2];
+
+    const Derived& Self() const { return static_cast<const Derived&>(*this); };
+
+    // Returns the new group, or NoGroup if there is no room for it or a cell is already in two groups
+    uint16_t    AddGroup( const tdCell* cells, uint8_t count )
+    {
+        if( GroupCount == MaxGroups || count > N )
+            return NoGroup;
+        for( uint8_t i = 0 ; i < count ; i++ )
+            if( CellGroups[cells[i]][1] != NoGroup )
+                return NoGroup;
+        uint16_t group = GroupCount++;
+        Sizes[group] = count;
+        for( uint8_t i = 0 ; i < count ; i++ )
+        {
+            Cells[group][i] = cells[i];
+            CellGroups[cells[i]][CellGroups[cells[i]][0] == NoGroup ? 0 : 1] = group;
+        }
+        return group;
+    }
+
+    // The filled in squares of a group
+    struct Tally
+    {
+        tdMask      Used = 0;
+        uint16_t    Sum = 0;
+        uint8_t     Filled = 0;
+        bool        Repeated = false;
+
+        void        Add( uint8_t val ) { Repeated |= (Used & Square::Bit(val)) != 0; Used |= Square::Bit(val); Sum += val; Filled++; };
+    };
+    template <class Board> Tally Count( const Board& board, uint16_t group, uint16_t skipCell = 0xFFFF ) const
+    {
+        Tally tally;
+        for( uint8_t i = 0 ; i < Sizes[group] ; i++ )
+        {
+            tdCell cell = Cells[group][i];
+            const Square& square = board.GetCell(cell);
+            if( cell != skipCell && square.Fixed() )
+                tally.Add(square.FirstPossible());
+        }
+        return tally;
+    }
+    tdMask      Allowed( uint16_t group, const Tally& tally ) const { return Self().GroupAllowed(group, tally.Used, tally.Sum, tally.Filled); };
+
+public:
+    uint16_t    Groups() const { return GroupCount; };
+    uint8_t     GroupSize( uint16_t group ) const { return Sizes[group]; };
+    const tdCell* GroupCells( uint16_t group ) const { return Cells[group]; };
+    void        ClearGroups() { GroupCount = 0; memset(CellGroups, 0xFF, sizeof(CellGroups)); };
+
+    // Only values already used are ruled out, unless Derived says otherwise
+    tdMask      GroupAllowed( uint16_t, tdMask used, uint16_t, uint8_t ) const { return Square::AllMask & ~used; };
+    bool        GroupComplete( uint16_t, uint16_t ) const { return true; };
+
+    template <class Board> bool Valid( const Board& board ) const
+    {
+        for( uint16_t group = 0 ; group < GroupCount ; group++ )
+        {
+            Tally tally = Count(board, group);
+            if( tally.Repeated )
+                return false;
+            if( tally.Filled == Sizes[group] ? !Self().GroupComplete(group, tally.Sum) : Allowed(group, tally) == 0 )
+                return false;
+        }
+        return true;
+    }
+
+    template <class Board> bool Possible( const Board& board, uint16_t cell, uint8_t val ) const
+    {
+        for( uint8_t i = 0 ; i < 2 && CellGroups[cell][i] != NoGroup ; i++ )
+            if( !(Allowed(CellGroups[cell][i], Count(board, CellGroups[cell][i], cell)) & Square::Bit(val)) )
+                return false;
+        return true;
+    }
+
+    template <class Board> bool Propagate( Board& board, SolveStats* stats ) const
+    {
+        bool bChangeMade = false;
+        for( uint16_t group = 0 ; group < GroupCount ; group++ )
+        {
+            tdMask allowed = Allowed(group, Count(board, group));
+            for( uint8_t i = 0 ; i < Sizes[group] ; i++ )
+            {
+                Square& square = board.GetCell(Cells[group][i]);
+                if( square.Fixed() || !(square.Mask() & ~allowed) )
+                    continue;
+                SOLVE_STAT(stats, Eliminations += Square::CountBits(square.Mask() & ~allowed));
+                square.SetMask(square.Mask() & allowed);
+                bChangeMade = true;
+            }
+        }
+        return bChangeMade;
+    }
+
+    struct Search
+    {
+        const Derived* Rules = nullptr;
+        tdMask      Used[MaxGroups];
+        uint16_t    Sum[MaxGroups];
+        uint8_t     Filled[MaxGroups];
+
+        template <class Board> void Init( const Derived& rules, const Board& board )
+        {
+            Rules = &rules;
+            for( uint16_t group = 0 ; group < rules.GroupCount ; group++ )
+            {
+                Tally tally = rules.Count(board, group);
+                Used[group] = tally.Used;
+                Sum[group] = tally.Sum;
+                Filled[group] = tally.Filled;
+            }
+        }
+        tdMask      Allowed( uint16_t cell ) const
+        {
+            tdMask mask = Square::AllMask;
+            for( uint8_t i = 0 ; i < 2 && Rules->CellGroups[cell][i] != NoGroup ; i++ )
+            {
+                uint16_t group = Rules->CellGroups[cell][i];
+                mask &= Rules->GroupAllowed(group, Used[group], Sum[group], Filled[group]);
+            }
+            return mask;
+        }
+        void        Place( uint16_t cell, uint8_t val )
+        {
+            for( uint8_t i = 0 ; i < 2 && Rules->CellGroups[cell][i] != NoGroup ; i++ )
+            {
+                uint16_t group = Rules->CellGroups[cell][i];
+                Used[group] |= Square::Bit(val);
+                Sum[group] += val;
+                Filled[group]++;
+            }
+        }
+        void        Unplace( uint16_t cell, uint8_t val )
+        {
+            for( uint8_t i = 0 ; i < 2 && Rules->CellGroups[cell][i] != NoGroup ; i++ )
+            {
+                uint16_t group = Rules->CellGroups[cell][i];
+                Used[group] &= ~Square::Bit(val);
+                Sum[group] -= val;
+                Filled[group]--;
+            }
+        }
+    };
+};
+
+// X sudoku, both long diagonals hold every value once
+template <uint8_t Box>
+class DiagonalRules : public GroupRules<Box, 2, DiagonalRules<Box>>
+{
+    using Base = GroupRules<Box, 2, DiagonalRules<Box>>;
+    using typename Base::tdCell;
+    using Base::N;
+
+public:
+    DiagonalRules()
+    {
+        tdCell down[N], up[N];
+        for( uint8_t i = 0 ; i < N ; i++ )
+        {
+            down[i] = i*N + i;
+            up[i] = i*N + N-1-i;
+        }
+        this->AddGroup(down, N);
+        this->AddGroup(up, N);
+    }
+};
+
+// Windoku, the blocks one square in from each corner and spaced a square apart also hold every value once
+template <uint8_t Box>
+class WindokuRules : public GroupRules<Box, (Box-1)*(Box-1), WindokuRules<Box>>
+{
+    using Base = GroupRules<Box, (Box-1)*(Box-1), WindokuRules<Box>>;
+    using typename Base::tdCell;
+    using Base::N;
+
+public:
+    WindokuRules()
+    {
+        tdCell window[N];
+        for( uint8_t wy = 0 ; wy < Box-1 ; wy++ )
+            for( uint8_t wx = 0 ; wx < Box-1 ; wx++ )
+            {
+                for( uint8_t i = 0 ; i < N ; i++ )
+                    window[i] = (1 + wy*(Box+1) + i/Box)*N + 1 + wx*(Box+1) + i%Box;
+                this->AddGroup(window, N);
+            }
+    }
+};
+
+// Killer sudoku, cages of cells whose values differ and add up to the cage's total
+template <uint8_t Box>
+class KillerRules : public GroupRules<Box, Box*Box*Box*Box, KillerRules<Box>>
+{
+    using Base = GroupRules<Box, Box*Box*Box*Box, KillerRules<Box>>;
+    using typename Base::tdMask;
+    using typename Base::tdCell;
+    using Base::N;
+    using Base::CellCount;
+
+    static constexpr uint16_t   MaxSum = N*(N+1)/2;
+    uint16_t    Totals[CellCount];
+
+public:
+    // Returns false if a cell is already in a cage
+    bool        AddCage( const tdCell* cells, uint8_t count, uint16_t total )
+    {
+        for( uint8_t i = 0 ; i < count ; i++ )
+            if( this->CellGroups[cells[i]][0] != Base::NoGroup )
+                return false;
+        uint16_t group = this->AddGroup(cells, count);
+        if( group == Base::NoGroup )
+            return false;
+        Totals[group] = total;
+        return true;
+    }
+    void        ClearCages() { this->ClearGroups(); };
+    uint16_t    CageTotal( uint16_t cage ) const { return Totals[cage]; };
+
+    // Splits a solved board into cages of one to maxSize squares. Each grows from the first square not yet
+    // in a cage into random free neighbours holding values it does not have yet, and totals what it covers.
+    template <class Board> void GenerateCages( const Board& solved, uint8_t maxSize = 4 )
+    {
+        ClearCages();
+        for( uint16_t start = 0 ; start < CellCount ; start++ )
+        {
+            if( this->CellGroups[start][0] != Base::NoGroup )
+                continue;
+            tdCell cells[N];
+            uint8_t count = 0;
+            tdMask used = 0;
+            uint16_t total = 0;
+            uint8_t size = random(1, (maxSize < N ? maxSize : N) + 1);
+            tdCell next = start;
+            while( true )
+            {
+                uint8_t val = solved.GetSquare(next%N, next/N).FirstPossible();
+                cells[count++] = next;
+                used |= Base::Square::Bit(val);
+                total += val;
+                if( count >= size )
+                    break;
+
+                tdCell options[4*N];
+                uint8_t optionCount = 0;
+                for( uint8_t i = 0 ; i < count ; i++ )
+                {
+                    uint8_t x = cells[i]%N;
+                    uint8_t y = cells[i]/N;
+                    const int8_t steps[4][2] = { {-1,0}, {1,0}, {0,-1}, {0,1} };
+                    for( auto& step : steps )
+                    {
+                        int16_t x2 = x + step[0];
+                        int16_t y2 = y + step[1];
+                        if( x2 < 0 || x2 >= N || y2 < 0 || y2 >= N )
+                            continue;
+                        tdCell neighbour = y2*N + x2;
+                        if( this->CellGroups[neighbour][0] == Base::NoGroup && !(used & Base::Square::Bit(solved.GetSquare(x2, y2).FirstPossible())) )
+                            options[optionCount++] = neighbour;
+                    }
+                }
+                if( optionCount == 0 )
+                    break;
+                next = options[random(0, optionCount)];
+            }
+            AddCage(cells, count, total);
+        }
+    }
+
+    tdMask      GroupAllowed( uint16_t group, tdMask used, uint16_t sum, uint8_t filled ) const
+    {
+        if( sum > Totals[group] )
+            return 0;
+        return Combinations(this->Sizes[group] - filled, Totals[group] - sum) & ~used;
+    }
+    bool        GroupComplete( uint16_t group, uint16_t sum ) const { return sum == Totals[group]; };
+
+    // The values found in any set of count different values adding up to total, built on first use
+    static tdMask Combinations( uint8_t count, uint16_t total )
+    {
+        static tdMask table[N+1][MaxSum+1];
+        static bool built = false;
+        if( !built )
+        {
+            // Adding each value in turn to every smaller set already found, largest first so it is only used once
+            bool found[N+1][MaxSum+1] = {};
+            found[0][0] = true;
+            for( uint8_t val = 1 ; val <= N ; val++ )
+                for( uint8_t k = val ; k > 0 ; k-- )
+                    for( uint16_t s = MaxSum ; s >= val ; s-- )
+                        if( found[k-1][s-val] )
+                        {
+                            found[k][s] = true;
+                            table[k][s] |= table[k-1][s-val] | Base::Square::Bit(val);
+                        }
+            built = true;
+        }
+        return count <= N && total <= MaxSum ? table[count][total] : 0;
+    }
+};
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 template <class T> struct Point {
     T x;
     T y;
@@ -20,8 +27,8 @@ template <class T> struct Size {
     Size() : cx(T{}), cy(T{}) {}; 
     Size( T x, T y ) : cx(x), cy(y) {}; 
 
-    bool operator==( const Size<T>& other ) { return cx == other.cx && cy == other.cy; };
-    bool operator!=( const Size<T>& other ) { return !(*this  == other); };
+    bool operator==( const Size<T>& other ) const { return cx == other.cx && cy == other.cy; };
+    bool operator!=( const Size<T>& other ) const { return !(*this  == other); };
 };
 
 template<class T> struct Rect {
@@ -53,7 +60,7 @@ template<class T> struct Rect {
   {
       return Rect<T>(left+x,top+y,right-2*x,bottom-2*y);
   }
-  Rect<T>   add( const Point<T>& pt )
+  Rect<T>   add( const Point<T>& pt ) const
   {
       return Rect<T>(left+pt.x,top+pt.y,right+pt.x,bottom+pt.y);
   }
@@ -65,4 +72,145 @@ template<class T> struct Rect {
   {
       return left <= x && x <= right && top <= y && y <= bottom;
   }
+  bool      overlaps( const Rect<T>& other ) const
+  {
+      return left <= other.right && other.left <= right && top <= other.bottom && other.top <= bottom;
+  }
+  bool      empty() const
+  {
+      return right <= left || bottom <= top;
+  }
+  bool      contains( const Rect<T>& other ) const
+  {
+      return left <= other.left && other.right <= right && top <= other.top && other.bottom <= bottom;
+  }
+  Rect<T>   intersect( const Rect<T>& other ) const
+  {
+      return Rect<T>(max(left,other.left), max(top,other.top), min(right,other.right), min(bottom,other.bottom));
+  }
+  // The part of this not covered by other, as far as a single rectangle can express it
+  Rect<T>   uncovered( const Rect<T>& other ) const
+  {
+      bool coversX = other.left <= left && right <= other.right;
+      bool coversY = other.top <= top && bottom <= other.bottom;
+      if( coversX && coversY )
+          return Rect<T>();
+      Rect<T> ret = *this;
+      if( coversX && other.top <= top && top < other.bottom )
+          ret.top = other.bottom;
+      else if( coversX && other.top < bottom && bottom <= other.bottom )
+          ret.bottom = other.top;
+      if( coversY && other.left <= left && left < other.right )
+          ret.left = other.right;
+      else if( coversY && other.left < right && right <= other.right )
+          ret.right = other.left;
+      return ret;
+  }
+};
+
+// Standard (reflected, 0xEDB88320) CRC-32, bitwise as it is only run over small blobs
+inline uint32_t Crc32( const void* data, size_t length, uint32_t crc = 0 )
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    crc = ~crc;
+    while( length-- )
+    {
+        crc ^= *bytes++;
+        for( uint8_t i = 0 ; i < 8 ; i++ )
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// A callable held in place rather than on the heap, for captures of up to Size bytes that can be copied
+// as plain bytes, which covers lambdas capturing this and a few values. Anything bigger fails to compile.
+template <class Signature, size_t Size = 2*sizeof(void*)> class InlineFunction;
+
+template <class R, class... Args, size_t Size>
+class InlineFunction<R(Args...),Size>
+{
+protected:
+    alignas(void*) uint8_t  Storage[Size];
+    R           (*Invoke)( const void* storage, Args... args ) = nullptr;
+
+    template <class F> static R Call( const void* storage, Args... args )
+    {
+        return (*(const F*)storage)(std::forward<Args>(args)...);
+    }
+
+public:
+    InlineFunction() = default;
+    InlineFunction( std::nullptr_t ) {};
+    template <class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type,InlineFunction>::value>::type>
+    InlineFunction( F&& func )
+    {
+        using Func = typename std::decay<F>::type;
+        static_assert(sizeof(Func) <= Size, "Capture too big for InlineFunction");
+        static_assert(alignof(Func) <= alignof(void*), "Capture too aligned for InlineFunction");
+        static_assert(std::is_trivially_copyable<Func>::value && std::is_trivially_destructible<Func>::value, "Capture must be plain data");
+        new (Storage) Func(std::forward<F>(func));
+        Invoke = &Call<Func>;
+    }
+
+    explicit operator bool() const { return Invoke != nullptr; };
+    R operator()( Args... args ) const { return Invoke(Storage, std::forward<Args>(args)...); };
+};
+
+// Text built up in a fixed buffer, anything past the end is dropped
+class TextBuffer
+{
+public:
+    static constexpr uint8_t Capacity = 160;       // Enough for a line of a log
+
+protected:
+    char        Text[Capacity];
+    uint8_t     Length = 0;
+
+    TextBuffer& AppendNumber( uint32_t value )
+    {
+        char digits[10];
+        uint8_t count = 0;
+        do
+            digits[count++] = '0' + value % 10;
+        while( (value /= 10) > 0 );
+        while( count > 0 )
+            *this << digits[--count];
+        return *this;
+    }
+
+public:
+    TextBuffer() { Text[0] = 0; };
+
+    const char* c_str() const { return Text; };
+    uint8_t     length() const { return Length; };
+    void        clear() { Length = 0; Text[0] = 0; };
+
+    TextBuffer& operator=( const char* str ) { clear(); return *this << str; };
+
+    TextBuffer& operator<<( const char* str )
+    {
+        size_t length = strlen(str);
+        if( length > Capacity-1u - Length )
+            length = Capacity-1u - Length;
+        memcpy(Text + Length, str, length);
+        Length += length;
+        Text[Length] = 0;
+        return *this;
+    }
+    TextBuffer& operator<<( char c )
+    {
+        if( Length < Capacity-1 )
+        {
+            Text[Length++] = c;
+            Text[Length] = 0;
+        }
+        return *this;
+    }
+    template <class T> typename std::enable_if<std::is_integral<T>::value,TextBuffer&>::type operator<<( T value )
+    {
+        if( !std::is_signed<T>::value || value >= 0 )
+            return AppendNumber((uint32_t)value);
+        *this << '-';
+        return AppendNumber(0u - (uint32_t)value);
+    }
 };
@@ -0,0 +1,93 @@
+#include "Validator.h"
+
+#include "InputManager.h"
+
+BackgroundValidator Validator;
+
+void BackgroundValidator::Start()
+{
+    Mutex = xSemaphoreCreateMutex();
+    Arena.Reserve(ScratchSize);
+    // Below the display task, so checking never holds up the screen
+    xTaskCreatePinnedToCore(ValidatorTask, "Validator", 8*1024, this, 1, &Task, 0);
+}
+
+void BackgroundValidator::Request( const SudokuState& state )
+{
+    if( !Task )
+        Start();
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    Pending = state;
+    HasPending = true;
+    HasResult = false;
+    Cancel = true;
+    xSemaphoreGive(Mutex);
+    xTaskNotifyGive(Task);
+}
+
+bool BackgroundValidator::GetResult( const SudokuState& state, uint8_t& result )
+{
+    if( !Task )
+        return false;
+    xSemaphoreTake(Mutex, portMAX_DELAY);
+    bool found = HasResult && state.ChangedSquares(Checked).none();
+    if( found )
+        result = Result;
+    xSemaphoreGive(Mutex);
+    return found;
+}
+
+const char* BackgroundValidator::Describe( uint8_t result, bool solved )
+{
+    return result == eUnique ? solved ? "Solved!" : "Valid" : result == eNonUnique ? "Non-unique" : "Invalid";
+}
+
+void BackgroundValidator::ValidatorTask( void* param )
+{
+    BackgroundValidator& self = *(BackgroundValidator*)param;
+    while( true )
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        SudokuState state;
+        xSemaphoreTake(self.Mutex, portMAX_DELAY);
+        bool hasPending = self.HasPending;
+        if( hasPending )
+            state = self.Pending;
+        self.HasPending = false;
+        self.Cancel = false;
+        xSemaphoreGive(self.Mutex);
+        if( !hasPending )
+            continue;
+
+        Input.InhibitSleep();
+        uint32_t ts = millis();
+        SudokuState temp = state;
+        temp.SetCancelFlag(&self.Cancel);
+        temp.SetArena(&self.Arena);
+        self.Arena.Reset();
+        temp.Propagate();
+        uint8_t result = temp.SolveUniquely();
+
+        xSemaphoreTake(self.Mutex, portMAX_DELAY);
+        // A newer request is waiting, and has already notified
+        bool cancelled = self.Cancel;
+        // A search cut short by the arena proves nothing, so there is no result to show
+        bool overflowed = self.Arena.HasOverflowed();
+        if( !cancelled && !overflowed )
+        {
+            self.Checked = state;
+            self.Result = result;
+            self.HasResult = true;
+        }
+        xSemaphoreGive(self.Mutex);
+        log_d("Validation %s after %dms", cancelled ? "cancelled" : overflowed ? "out of scratch" : Describe(result, state.Solved()), millis()-ts);
+
+        if( !cancelled )
+        {
+            self.Finished = true;
+            Input.Wake();
+        }
+        Input.AllowSleep();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "SudokuState.h"
+
+// Checks boards without a known solution for a unique solution on a low priority task, with scratch of its own.
+// A new request cancels the check in progress, the UI loop is woken when a check finishes.
+class BackgroundValidator
+{
+public:
+    enum eResult : uint8_t {
+        eInvalid    = 0,        // As returned by SudokuBoard::SolveUniquely
+        eUnique     = 1,
+        eNonUnique  = 2,
+    };
+
+protected:
+    static constexpr size_t ScratchSize = 4*1024;      // Only the search state
+
+    TaskHandle_t        Task = nullptr;
+    SemaphoreHandle_t   Mutex = nullptr;
+    SudokuState         Pending;
+    bool                HasPending = false;
+    SudokuState         Checked;            // The board Result is for
+    uint8_t             Result = eInvalid;
+    bool                HasResult = false;
+    std::atomic<bool>   Cancel{false};
+    std::atomic<bool>   Finished{false};
+    ScratchArena        Arena;
+
+    void                Start();
+    static void         ValidatorTask( void* );
+
+public:
+    void        Request( const SudokuState& state );
+    // returns false if state has not been checked, or its check is still running
+    bool        GetResult( const SudokuState& state, uint8_t& result );
+    // true once after each check finishes
+    bool        TakeFinished() { return Finished.exchange(false); };
+
+    static const char* Describe( uint8_t result, bool solved );
+};
+
+extern BackgroundValidator Validator;
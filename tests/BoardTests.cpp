@@ -0,0 +1,156 @@
+#include "SudokuState.h"
+
+#include "TestCheck.h"
+
+// Every cell's peers share its row, column or block, and there are no repeats
+template <uint8_t Box>
+static void TestPeers()
+{
+    using Board = SudokuBoard<Box>;
+    const uint8_t N = Board::N;
+    for( uint16_t cell = 0 ; cell < Board::CellCount ; cell++ )
+    {
+        typename Board::tdCellSet seen;
+        const typename Board::tdCell* peers = Board::PeersOf(cell);
+        for( uint8_t i = 0 ; i < Board::PeerCount ; i++ )
+        {
+            uint16_t peer = peers[i];
+            CHECK(peer != cell);
+            CHECK(!seen[peer]);
+            seen.set(peer);
+            CHECK(peer%N == cell%N || peer/N == cell/N || (peer%N/Box == cell%N/Box && peer/N/Box == cell/N/Box));
+        }
+    }
+    for( uint8_t unit = 0 ; unit < Board::UnitCount ; unit++ )
+    {
+        typename Board::tdCellSet seen;
+        for( uint8_t i = 0 ; i < N ; i++ )
+            seen.set(Board::UnitCells(unit)[i]);
+        CHECK(seen.count() == N);
+    }
+}
+
+// A full board made by shifting each row, with the squares where keep() is false left empty
+template <uint8_t Box, class Keep>
+static void MakePuzzle( SudokuBoard<Box>& board, Keep keep )
+{
+    const uint8_t N = Box*Box;
+    board.GenerateEmpty();
+    for( uint8_t y = 0 ; y < N ; y++ )
+        for( uint8_t x = 0 ; x < N ; x++ )
+            if( keep(x,y) )
+                board.GetSquare(x,y).SetSolution((y%Box*Box + y/Box + x) % N + 1);
+    board.MarkFixedAsGiven();
+}
+
+template <uint8_t Box>
+static void CheckSolved( SudokuBoard<Box>& board )
+{
+    const uint8_t N = Box*Box;
+    CHECK(board.Solved());
+    for( uint8_t y = 0 ; y < N ; y++ )
+        for( uint8_t x = 0 ; x < N ; x++ )
+            if( board.IsGiven(x,y) )
+                CHECK(board.GetSquare(x,y).FirstPossible() == (y%Box*Box + y/Box + x) % N + 1);
+}
+
+static void TestSmallAndLarge()
+{
+    // One square missing from each row can only be filled one way
+    SudokuBoard<2> small;
+    MakePuzzle(small, []( uint8_t x, uint8_t y ) { return x != y; });
+    CHECK(small.Valid());
+    CHECK(small.SolveUniquely() == 1);
+    CHECK(small.EnsureSolution());
+    small.Propagate();
+    CHECK(small.SolveByGuessing());
+    CheckSolved(small);
+
+    SudokuBoard<2> empty;
+    empty.GenerateEmpty();
+    CHECK(empty.SolveUniquely() == 2);
+    CHECK(empty.SolveByGuessing());
+    CHECK(empty.Solved());
+
+    SudokuBoard<4> large;
+    MakePuzzle(large, []( uint8_t x, uint8_t y ) { return (x*7 + y*3) % 4 != 0; });
+    CHECK(large.Valid());
+    CHECK(large.SolveUniquely() >= 1);
+    large.Propagate();
+    CHECK(large.SolveByGuessing());
+    CheckSolved(large);
+
+    // Two of the same value in a row is caught
+    large.GetSquare(0,0).SetSolution(large.GetSquare(1,0).FirstPossible());
+    CHECK(!large.Valid());
+}
+
+// A placed value is taken out of its peers and nowhere else, and a repeat in any unit is caught
+static void TestPropagateAndValid()
+{
+    SudokuBoard<3> board;
+    board.GenerateEmpty();
+    board.GetSquare(4,4).SetSolution(5);
+    CHECK(board.Propagate());
+    std::bitset<81> peers;
+    for( uint8_t i = 0 ; i < SudokuBoard<3>::PeerCount ; i++ )
+        peers.set(SudokuBoard<3>::PeersOf(4*9+4)[i]);
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        if( cell != 4*9+4 )
+            CHECK(board.GetSquare(cell%9, cell/9).Possible(5) != peers[cell]);
+    CHECK(board.Valid());
+
+    SudokuBoard<3> column = board;
+    column.GetSquare(4,0).SetSolution(5);
+    CHECK(!column.Valid());
+    SudokuBoard<3> block = board;
+    block.GetSquare(3,5).SetSolution(5);
+    CHECK(!block.Valid());
+    SudokuBoard<3> apart = board;
+    apart.GetSquare(0,0).SetSolution(5);
+    CHECK(apart.Valid());
+}
+
+static void TestAutoMarks()
+{
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    // Row 0 is "53..7....", the player has marked up (5,0) and taken 4 out
+    state.GetSquare(5,0).SetMask(state.PossibleMask(5,0) & ~(1 << 3));
+
+    // Placing 8 takes it out of the marked peer, and empty peers are marked up too
+    SudokuSquare before = state.GetSquare(6,0);
+    state.GetSquare(6,0).SetSolution(8);
+    std::bitset<81> changed = state.UpdatePeerCandidates(6, 0, before);
+    CHECK(changed[5] && changed[8]);
+    CHECK(state.GetSquare(5,0).Mask() == (1 << 1 | 1 << 5));
+    CHECK(state.GetSquare(8,0).Mask() == (1 << 1 | 1 << 3));
+    CHECK(!changed[0] && !changed[1]);
+
+    // Taking it out again puts 8 back where it can go, and 4 stays out of (5,0)
+    before = state.GetSquare(6,0);
+    state.GetSquare(6,0) = SudokuSquare();
+    changed = state.UpdatePeerCandidates(6, 0, before);
+    CHECK(state.GetSquare(5,0).Mask() == (1 << 1 | 1 << 5 | 1 << 7));
+    CHECK(state.GetSquare(8,0).Mask() == (1 << 1 | 1 << 3 | 1 << 7));
+
+    // A peer can end up with one value, which counts as placed
+    state.GetSquare(2,0).SetMask(1 << 0 | 1 << 1);
+    before = state.GetSquare(7,0);
+    state.GetSquare(7,0).SetSolution(2);
+    state.UpdatePeerCandidates(7, 0, before);
+    CHECK(state.GetSquare(2,0).Fixed());
+    CHECK(state.GetSquare(2,0).FirstPossible() == 1);
+}
+
+int main()
+{
+    TestPeers<2>();
+    TestPeers<3>();
+    TestPeers<4>();
+    TestSmallAndLarge();
+    TestPropagateAndValid();
+    TestAutoMarks();
+    printf("BoardTests: %d failed\n", Failures);
+    return Failures;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+
+#include "Canonicaliser.h"
+#include "SudokuState.h"
+
+#include "TestCheck.h"
+
+static const char* OtherPuzzle = "4.....8.5.3..........7......2.....6.....8.4......1.......6.3.7.5..2.....1.4......";
+
+static void FromText( const char* text, uint8_t* values )
+{
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        values[cell] = text[cell] == '.' ? 0 : text[cell] - '0';
+}
+
+// A random mix of the changes the canonical form ignores
+static void Scramble( const uint8_t* values, uint8_t* result )
+{
+    uint8_t bands[3] = { 0, 1, 2 }, stacks[3] = { 0, 1, 2 };
+    uint8_t rows[9], cols[9], labels[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    auto pick = []( int i ) { return (int)random(i); };
+    std::random_shuffle(bands, bands + 3, pick);
+    std::random_shuffle(stacks, stacks + 3, pick);
+    std::random_shuffle(labels + 1, labels + 10, pick);
+    for( uint8_t i = 0 ; i < 3 ; i++ )
+    {
+        uint8_t inBand[3] = { 0, 1, 2 }, inStack[3] = { 0, 1, 2 };
+        std::random_shuffle(inBand, inBand + 3, pick);
+        std::random_shuffle(inStack, inStack + 3, pick);
+        for( uint8_t j = 0 ; j < 3 ; j++ )
+        {
+            rows[i*3+j] = bands[i]*3 + inBand[j];
+            cols[i*3+j] = stacks[i]*3 + inStack[j];
+        }
+    }
+    bool transpose = random(2);
+    for( uint8_t y = 0 ; y < 9 ; y++ )
+        for( uint8_t x = 0 ; x < 9 ; x++ )
+        {
+            uint8_t from = transpose ? cols[x]*9 + rows[y] : rows[y]*9 + cols[x];
+            result[y*9+x] = labels[values[from]];
+        }
+}
+
+static void TestSymmetries( const char* puzzle )
+{
+    Canonicaliser<3> canonicaliser;
+    uint8_t values[81], changed[81], formA[81], formB[81];
+    FromText(puzzle, values);
+    uint64_t hash = canonicaliser.Hash(values);
+    CHECK(hash != 0);
+    canonicaliser.Canonical(values, formA);
+    for( uint8_t i = 0 ; i < 20 ; i++ )
+    {
+        Scramble(values, changed);
+        CHECK(canonicaliser.Hash(changed) == hash);
+        canonicaliser.Canonical(changed, formB);
+        CHECK(memcmp(formA, formB, sizeof(formA)) == 0);
+    }
+
+    // The board's own hash is of its givens
+    SudokuState state;
+    SetPuzzle(state, puzzle);
+    CHECK(state.CanonicalHash() == hash);
+    state.SolveByGuessing();
+    CHECK(state.CanonicalHash() == hash);
+}
+
+// Complete grids take a different path through the search
+static void TestCompleteGrid()
+{
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    state.SolveByGuessing();
+    uint8_t values[81], changed[81];
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        values[cell] = state.GetSquare(cell%9, cell/9).FirstPossible();
+    Canonicaliser<3> canonicaliser;
+    uint64_t hash = canonicaliser.Hash(values);
+    for( uint8_t i = 0 ; i < 5 ; i++ )
+    {
+        Scramble(values, changed);
+        CHECK(canonicaliser.Hash(changed) == hash);
+    }
+}
+
+static void TestDifferentPuzzles()
+{
+    SudokuState a, b;
+    SetPuzzle(a, TestPuzzle);
+    SetPuzzle(b, OtherPuzzle);
+    CHECK(a.CanonicalHash() != b.CanonicalHash());
+
+    // One more clue is a different puzzle
+    char text[82];
+    strcpy(text, TestPuzzle);
+    text[2] = '4';
+    SudokuState more;
+    SetPuzzle(more, text);
+    CHECK(more.CanonicalHash() != a.CanonicalHash());
+}
+
+// Transposing, swapping the two bands and relabelling 1 and 3
+static void TestSmallBoard()
+{
+    const uint8_t puzzle[16] = {
+        1,0,0,4,
+        0,0,1,0,
+        0,1,0,0,
+        2,0,0,3 };
+    const uint8_t relabel[5] = { 0, 3, 2, 1, 4 };
+    uint8_t changed[16];
+    for( uint8_t y = 0 ; y < 4 ; y++ )
+        for( uint8_t x = 0 ; x < 4 ; x++ )
+            changed[((y + 2) % 4)*4 + x] = relabel[puzzle[x*4 + y]];
+
+    Canonicaliser<2> canonicaliser;
+    uint8_t formA[16], formB[16];
+    canonicaliser.Canonical(puzzle, formA);
+    canonicaliser.Canonical(changed, formB);
+    CHECK(memcmp(formA, formB, sizeof(formA)) == 0);
+    CHECK(canonicaliser.Hash(puzzle) == canonicaliser.Hash(changed));
+}
+
+int main()
+{
+    TestSymmetries(TestPuzzle);
+    TestSymmetries(OtherPuzzle);
+    TestCompleteGrid();
+    TestDifferentPuzzles();
+    TestSmallBoard();
+    printf("CanonicaliserTests: %d failed\n", Failures);
+    return Failures;
+}
@@ -0,0 +1,136 @@
+#include <Preferences.h>
+
+#include "MoveJournal.h"
+#include "SaveSlots.h"
+#include "SudokuState.h"
+
+#include "TestCheck.h"
+
+static bool Same( const SudokuState& a, const SudokuState& b )
+{
+    SudokuSaveBlob blobA, blobB;
+    a.ToBlob(blobA);
+    b.ToBlob(blobB);
+    return memcmp(&blobA, &blobB, sizeof(blobA)) == 0;
+}
+
+// As after a power cycle, only what is in NVS
+static bool Reload( SudokuState& state )
+{
+    SaveSlots saves;
+    MoveJournal journal;
+    state = SudokuState();
+    if( !saves.LoadCurrent(state) )
+        return false;
+    journal.Restore(state);
+    return true;
+}
+
+static void NewGame( SudokuState& state )
+{
+    SetPuzzle(state, TestPuzzle);
+    Journal.Clear();
+    Saves.StartNew(state);
+}
+
+// Toggles candidates in the empty squares, count moves from the first
+static void MakeMoves( SudokuState& state, uint16_t first, uint16_t count )
+{
+    for( uint16_t move = first ; move < first + count ; move++ )
+    {
+        uint8_t cell = move % 81;
+        while( state.GetSquare(cell%9, cell/9).Fixed() )
+            cell = (cell + 1) % 81;
+        uint8_t digit = move / 81 % 9 + 1;
+        Point<uint8_t> square(cell%9, cell/9);
+        if( state.GetSquare(square.x, square.y).Possible(digit) )
+            Journal.Record(state, square, JournalEntry::eRemove, digit);
+        else
+            Journal.Record(state, square, JournalEntry::eAdd, digit);
+    }
+}
+
+static void TestReplay()
+{
+    SudokuState state;
+    NewGame(state);
+    MakeMoves(state, 0, 20);
+    SudokuState restored;
+    CHECK(Reload(restored));
+    CHECK(Same(restored, state));
+}
+
+// Past four chunks a snapshot is taken and the journal starts again
+static void TestReplayAfterCompaction()
+{
+    SudokuState state;
+    NewGame(state);
+    MakeMoves(state, 0, 100);
+    CHECK(!Preferences::Keys.count("J3"));
+    SudokuState restored;
+    CHECK(Reload(restored));
+    CHECK(Same(restored, state));
+
+    // Undoing to before the snapshot takes another
+    for( uint8_t i = 0 ; i < 50 ; i++ )
+        Journal.Undo(state);
+    CHECK(Reload(restored));
+    CHECK(Same(restored, state));
+}
+
+// The moves already journalled must survive a snapshot that could not be written
+static void TestFailedCompaction()
+{
+    SudokuState state;
+    NewGame(state);
+    MakeMoves(state, 0, 60);
+    SudokuState persisted = state;
+    Preferences::FailWrites = true;
+    MakeMoves(state, 60, 10);
+    Preferences::FailWrites = false;
+    SudokuState restored;
+    CHECK(Reload(restored));
+    CHECK(Same(restored, persisted));
+}
+
+static uint16_t UndoAll( SudokuState& state )
+{
+    uint16_t undone = 0;
+    while( Journal.CanUndo() )
+    {
+        Journal.Undo(state);
+        undone++;
+    }
+    return undone;
+}
+
+// The undo history is capped, even when no snapshot could be taken for a long time
+static void TestHistoryLimit()
+{
+    SudokuState state;
+    NewGame(state);
+    MakeMoves(state, 0, 600);
+    SudokuState restored;
+    CHECK(Reload(restored));
+    CHECK(Same(restored, state));
+    CHECK(UndoAll(state) <= 512);
+
+    NewGame(state);
+    Preferences::FailWrites = true;
+    MakeMoves(state, 0, 600);
+    Preferences::FailWrites = false;
+    MakeMoves(state, 600, 1);
+    CHECK(Reload(restored));
+    CHECK(Same(restored, state));
+    CHECK(UndoAll(state) <= 512);
+}
+
+int main()
+{
+    TestReplay();
+    TestReplayAfterCompaction();
+    TestFailedCompaction();
+    TestHistoryLimit();
+    printf("MoveJournalTests: %d failed\n", Failures);
+    return Failures;
+}
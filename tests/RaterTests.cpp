@@ -0,0 +1,98 @@
+#include "DifficultyRater.h"
+
+#include "TestCheck.h"
+
+// Rated by the ladder as needing each technique at most, in order, found with GenerateRandom
+static const char* TechniquePuzzles[Rating::eTechniqueCount + 1] = {
+    ".1.5.2...6..41.3.5.4...92.6...83.4...3...685.7.........5..8.1.49.1....7...37.....",
+    ".65.4...1.....6.87...3..2..2.......6318...9.......2.4.......8.........7..2.1..6..",
+    ".6.........9785.2....93.....8..4.27.1....8.....6..7.9.2.......8........5..3.5.1..",
+    "....34.....5....7...69..1....8...2.....7...58.3.......74...13..9..5.........6..2.",
+    "...5..9...2.4...3.6...1.............8..7.5..4.4.....92........9.5....7...32.64...",
+    "8...5..9....6...4.9.7..8...43...9.1....1...6...9........3..7.......6...421.....5.",
+    "......9.2..8.......4..67...2....1..63..7...9...9358....3.........7..35...1...54..",
+    "2...98..1.78.......5...7...83..1..4..........4..9.278.7..5....4....2..6...93.....",
+};
+
+// Lets the test see what the rater has left in each square
+class TestRater : public DifficultyRater<3>
+{
+public:
+    tdMask      CandidatesOf( uint16_t cell ) const { return Candidates[cell]; };
+};
+
+static void LoadPuzzle( SudokuBoard<3>& board, const char* text )
+{
+    board.GenerateEmpty();
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        if( text[cell] != '.' )
+            board.GetCell(cell).SetSolution(text[cell] - '0');
+    board.MarkFixedAsGiven();
+}
+
+// Each puzzle needs its technique, and no technique takes out the right value
+static void TestTechniques()
+{
+    TestRater rater;
+    for( uint8_t technique = 0 ; technique <= Rating::eTechniqueCount ; technique++ )
+    {
+        SudokuBoard<3> board;
+        LoadPuzzle(board, TechniquePuzzles[technique]);
+        CHECK(board.SolveUniquely() == 1);
+        Rating rating = rater.Rate(board);
+        CHECK(rating.Hardest == technique);
+        CHECK(!rating.Capped);
+        CHECK(rating.Solved == (technique != Rating::eGuessing));
+        if( technique != Rating::eGuessing )
+            CHECK(rating.Steps[technique] > 0);
+
+        CHECK(board.SolveByGuessing());
+        for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+            CHECK(rater.CandidatesOf(cell) == 0 || (rater.CandidatesOf(cell) & board.GetCell(cell).Mask()));
+    }
+}
+
+// A low cap stops the rater early, and the puzzle counts as needing guesses
+static void TestCostCap()
+{
+    TestRater rater;
+    SudokuBoard<3> board;
+    LoadPuzzle(board, TechniquePuzzles[Rating::eFish]);
+    Rating rating = rater.Rate(board, 100);
+    CHECK(rating.Capped);
+    CHECK(!rating.Solved);
+    CHECK(rating.Hardest == Rating::eGuessing);
+    CHECK(rating.Cost < 1000);
+    CHECK(rating.Score() > rater.Rate(board).Score());
+}
+
+// Each level's puzzle is in its band, has one solution and keeps the givens of that solution
+static void TestGenerateToBand()
+{
+    TestRater rater;
+    for( uint8_t level = 0 ; level < DifficultyBand::eLevelCount ; level++ )
+    {
+        const DifficultyBand& band = DifficultyBand::Get((DifficultyBand::eLevel)level);
+        SudokuBoard<3> board;
+        Rating rating = rater.Generate(board, band);
+        CHECK(band.Contains(rating));
+        CHECK(board.CountGivens() <= band.MaxClues);
+        CHECK(rater.Rate(board).Hardest == rating.Hardest);
+        CHECK(board.SolveUniquely() == 1);
+        SudokuBoard<3> solved = board;
+        CHECK(solved.SolveByGuessing());
+        CHECK(board.HasSolution());
+        CHECK(board.FindMistakes().none());
+        for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+            CHECK(!solved.IsMistake(cell%9, cell/9));
+    }
+}
+
+int main()
+{
+    TestTechniques();
+    TestCostCap();
+    TestGenerateToBand();
+    printf("RaterTests: %d failed\n", Failures);
+    return Failures;
+}
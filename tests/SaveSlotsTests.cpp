@@ -0,0 +1,201 @@
+#include <Preferences.h>
+#include <vector>
+
+#include "SaveSlots.h"
+#include "SudokuState.h"
+
+#include "TestCheck.h"
+
+extern Preferences preferences;
+
+static bool Same( SudokuState& a, SudokuState& b )
+{
+    for( uint8_t y = 0 ; y < 9 ; y++ )
+        for( uint8_t x = 0 ; x < 9 ; x++ )
+            if( a.GetSquare(x,y).Mask() != b.GetSquare(x,y).Mask() || a.IsGiven(x,y) != b.IsGiven(x,y) )
+                return false;
+    return true;
+}
+
+static void TestBlobCrc()
+{
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    SudokuSaveBlob blob;
+    state.ToBlob(blob);
+    SudokuState loaded;
+    CHECK(loaded.FromBlob(blob));
+    CHECK(Same(loaded, state));
+
+    SudokuSaveBlob corrupt = blob;
+    corrupt.Candidates[40] ^= 1 << 3;
+    CHECK(!loaded.FromBlob(corrupt));
+
+    // A later version is not read even if its CRC is good
+    SudokuSaveBlob newer = blob;
+    newer.Version++;
+    newer.Crc = newer.CalculateCrc();
+    CHECK(!loaded.FromBlob(newer));
+}
+
+static void TestSaveAndLoad()
+{
+    Preferences::Keys.clear();
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    SaveSlots saves;
+    saves.StartNew(state);
+    state.GetSquare(2,0).RemovePossible(4);
+    CHECK(saves.Save(state));
+
+    SaveSlots reloaded;
+    SudokuState loaded;
+    CHECK(reloaded.LoadCurrent(loaded));
+    CHECK(Same(loaded, state));
+    CHECK(reloaded.GetInfo(reloaded.GetCurrent()).Clues == 30);
+}
+
+// A write that fails is reported, so the journal is kept
+static void TestFailedSave()
+{
+    Preferences::Keys.clear();
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    SaveSlots saves;
+    saves.StartNew(state);
+    SudokuState saved = state;
+
+    state.GetSquare(2,0).RemovePossible(4);
+    Preferences::FailWrites = true;
+    CHECK(!saves.Save(state));
+    Preferences::FailWrites = false;
+
+    SaveSlots reloaded;
+    SudokuState loaded;
+    CHECK(reloaded.LoadCurrent(loaded));
+    CHECK(Same(loaded, saved));
+    CHECK(saves.Save(state));
+}
+
+// Each new game takes a slot, the old one can still be picked
+static void TestSlots()
+{
+    Preferences::Keys.clear();
+    SudokuState first;
+    SetPuzzle(first, TestPuzzle);
+    SaveSlots saves;
+    saves.StartNew(first);
+    SudokuState second = first;
+    second.GetSquare(2,0).RemovePossible(4);
+    saves.StartNew(second);
+    CHECK(saves.GetCurrent() == 1);
+
+    SaveSlots reloaded;
+    SudokuState loaded;
+    CHECK(reloaded.Load(loaded, 0));
+    CHECK(Same(loaded, first));
+    CHECK(reloaded.GetCurrent() == 0);
+    CHECK(reloaded.Load(loaded, 1));
+    CHECK(Same(loaded, second));
+    CHECK(!reloaded.Load(loaded, 2));
+}
+
+// The single save from before slots becomes slot 0, from either older format
+static void TestMigrate()
+{
+    Preferences::Keys.clear();
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    SudokuSaveBlob blob;
+    state.ToBlob(blob);
+    preferences.putBytes("Game", &blob, sizeof(blob));
+
+    SaveSlots saves;
+    SudokuState loaded;
+    CHECK(saves.LoadCurrent(loaded));
+    CHECK(Same(loaded, state));
+    CHECK(!Preferences::Keys.count("Game"));
+
+    // "Saved" plus a key of three squares, 9 bits each, for every third cell
+    Preferences::Keys.clear();
+    preferences.putBool("Saved", true);
+    for( uint8_t y = 0 ; y < 9 ; y++ )
+        for( uint8_t x = 0 ; x < 9 ; x += 3 )
+        {
+            uint32_t threeSquares = 0;
+            for( uint8_t j = 0 ; j < 3 ; j++ )
+                threeSquares |= (uint32_t)state.GetSquare(x+j,y).Mask() << (j*9);
+            preferences.putULong(String(y*9+x).c_str(), threeSquares);
+        }
+
+    SaveSlots legacy;
+    CHECK(legacy.LoadCurrent(loaded));
+    for( uint8_t y = 0 ; y < 9 ; y++ )
+        for( uint8_t x = 0 ; x < 9 ; x++ )
+            CHECK(loaded.GetSquare(x,y).Mask() == state.GetSquare(x,y).Mask());
+    // Only the index and the slot are left
+    CHECK(Preferences::Keys.size() == 2);
+}
+
+// Version 1 of the index had no hash in each slot, written out field by field as it was laid out
+static std::vector<uint8_t> IndexV1( uint8_t current, uint32_t sequence )
+{
+    std::vector<uint8_t> data;
+    auto add = [&data]( uint32_t value, uint8_t size ) { data.insert(data.end(), (uint8_t*)&value, (uint8_t*)&value + size); };
+    add(1, 1);
+    add(current, 1);
+    add(sequence, 4);
+    for( uint8_t slot = 0 ; slot < SaveIndexBlob::MaxSlots ; slot++ )
+    {
+        add(slot == current ? SaveSlotInfo::eInUse : 0, 1);
+        add(30, 1);
+        add(40 + slot, 1);
+        add(1000 + slot, 4);
+        add(slot, 4);
+    }
+    add(Crc32(data.data(), data.size()), 4);
+    return data;
+}
+
+static void TestIndexUpgrade()
+{
+    Preferences::Keys.clear();
+    Preferences::Keys["Index"] = IndexV1(2, 7);
+    SaveSlots saves;
+    CHECK(saves.GetCurrent() == 2);
+    const SaveSlotInfo& info = saves.GetInfo(2);
+    CHECK(info.InUse());
+    CHECK(info.Clues == 30);
+    CHECK(info.Filled == 42);
+    CHECK(info.ElapsedS == 1002);
+    CHECK(info.LastPlayed == 2);
+    CHECK(info.Hash == 0);
+    CHECK(!saves.GetInfo(1).InUse());
+    CHECK(saves.GetInfo(5).ElapsedS == 1005);
+
+    // Written back as the current version
+    SaveSlots reloaded;
+    CHECK(Preferences::Keys["Index"].size() == sizeof(SaveIndexBlob));
+    CHECK(reloaded.GetCurrent() == 2);
+    CHECK(reloaded.GetInfo(2).ElapsedS == 1002);
+
+    // A damaged version 1 index is started again rather than trusted
+    Preferences::Keys.clear();
+    Preferences::Keys["Index"] = IndexV1(2, 7);
+    Preferences::Keys["Index"][3] ^= 0xFF;
+    SaveSlots damaged;
+    CHECK(damaged.GetCurrent() == 0);
+    CHECK(!damaged.GetInfo(2).InUse());
+}
+
+int main()
+{
+    TestBlobCrc();
+    TestSaveAndLoad();
+    TestFailedSave();
+    TestSlots();
+    TestMigrate();
+    TestIndexUpgrade();
+    printf("SaveSlotsTests: %d failed\n", Failures);
+    return Failures;
+}
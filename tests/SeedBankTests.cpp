@@ -0,0 +1,70 @@
+#include "DifficultyRater.h"
+#include "SeedBank.h"
+
+#include "TestCheck.h"
+
+// Every seed has one solution and is rated in its level's band
+static void TestSeedBands()
+{
+    DifficultyRater<3> rater;
+    for( uint8_t level = 0 ; level < DifficultyBand::eLevelCount ; level++ )
+    {
+        const DifficultyBand& band = DifficultyBand::Get((DifficultyBand::eLevel)level);
+        CHECK(SeedBank::Count((DifficultyBand::eLevel)level) > 0);
+        for( uint8_t i = 0 ; i < SeedBank::Count((DifficultyBand::eLevel)level) ; i++ )
+        {
+            SudokuState state;
+            CHECK(state.GenerateFromText(SeedBank::Seed((DifficultyBand::eLevel)level, i)));
+            CHECK(state.SolveUniquely() == 1);
+            CHECK(band.Contains(rater.Rate(state)));
+        }
+    }
+}
+
+// A transformed board is the same puzzle: still unique, rated the same, with the same hash,
+// and its givens, marks and stored solution still agree
+static void TestSymmetry()
+{
+    DifficultyRater<3> rater;
+    SudokuState state;
+    CHECK(state.GenerateFromText(SeedBank::Seed(DifficultyBand::eMedium, 0)));
+    state.Propagate();
+    Rating rating = rater.Rate(state);
+    uint64_t hash = state.CanonicalHash();
+    uint16_t givens = state.CountGivens();
+    uint16_t sum = state.SumCount();
+    for( uint8_t i = 0 ; i < 20 ; i++ )
+    {
+        SudokuState changed = state;
+        changed.ApplyRandomSymmetry();
+        CHECK(changed.Valid());
+        CHECK(changed.SolveUniquely() == 1);
+        CHECK(changed.CountGivens() == givens);
+        CHECK(changed.SumCount() == sum);
+        CHECK(changed.CanonicalHash() == hash);
+        CHECK(rater.Rate(changed).Hardest == rating.Hardest);
+        CHECK(changed.FindMistakes().none());
+        for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+            CHECK(!changed.IsGiven(cell%9, cell/9) || changed.GetSquare(cell%9, cell/9).Fixed());
+        CHECK(changed.SolveByGuessing());
+        CHECK(changed.FindMistakes().none());
+    }
+}
+
+static void TestDraw()
+{
+    SudokuState state;
+    CHECK(SeedBank::Draw(state, DifficultyBand::eHard));
+    CHECK(state.HasSolution());
+    CHECK(DifficultyBand::Get(DifficultyBand::eHard).Contains(DifficultyRater<3>().Rate(state)));
+    CHECK(!SeedBank::Draw(state, DifficultyBand::eLevelCount));
+}
+
+int main()
+{
+    TestSeedBands();
+    TestSymmetry();
+    TestDraw();
+    printf("SeedBankTests: %d failed\n", Failures);
+    return Failures;
+}
@@ -0,0 +1,87 @@
+#include "SudokuState.h"
+
+#include "TestCheck.h"
+
+static void TestSolveUniquely()
+{
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    SolveStats stats;
+    CHECK(state.SolveUniquely(&stats) == 1);
+    // Every guess on the way to the one solution found it, every other one was a dead end
+    CHECK(stats.Guesses >= 51);
+    CHECK(stats.Backtracks == stats.Guesses - 51);
+
+    // With a given removed there is more than one
+    SetPuzzle(state, TestPuzzle);
+    state.GetSquare(0,0) = SudokuSquare();
+    state.GetSquare(1,0) = SudokuSquare();
+    state.GetSquare(4,0) = SudokuSquare();
+    CHECK(state.SolveUniquely() == 2);
+}
+
+static void TestSolveByGuessing()
+{
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    SolveStats stats;
+    CHECK(state.SolveByGuessing(64, &stats));
+    CHECK(state.Solved());
+    CHECK(state.Valid());
+    CHECK(stats.Backtracks <= stats.Guesses);
+}
+
+static void TestEnsureSolution()
+{
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    CHECK(state.EnsureSolution());
+    CHECK(state.HasSolution());
+
+    // Clues follow the solution until the board is full
+    for( uint8_t i = 0 ; i < 81 && !state.Solved() ; i++ )
+        CHECK(state.FixOneSquare(i % 2 ? SudokuState::eHintLogical : SudokuState::eHintReveal).x >= 0);
+    CHECK(state.Solved());
+    CHECK(state.Valid());
+
+    // More than one solution, so none is kept
+    SetPuzzle(state, TestPuzzle);
+    state.GetSquare(0,0) = SudokuSquare();
+    state.GetSquare(1,0) = SudokuSquare();
+    state.GetSquare(4,0) = SudokuSquare();
+    state.MarkFixedAsGiven();
+    CHECK(!state.EnsureSolution());
+    CHECK(!state.HasSolution());
+    CHECK(state.FixOneSquare().x == -1);
+}
+
+// Too small an arena gives no answer rather than a wrong one, until it is reset
+static void TestArenaOverflow()
+{
+    ScratchArena arena;
+    CHECK(arena.Reserve(64));
+    SudokuState state;
+    SetPuzzle(state, TestPuzzle);
+    state.SetArena(&arena);
+    CHECK(state.SolveUniquely() == 0);
+    CHECK(arena.HasOverflowed());
+    arena.Reset();
+    CHECK(!arena.HasOverflowed());
+    CHECK(!state.EnsureSolution());
+    CHECK(!state.HasSolution());
+    CHECK(arena.HasOverflowed());
+
+    CHECK(arena.Reserve());
+    CHECK(state.SolveUniquely() == 1);
+    CHECK(!arena.HasOverflowed());
+}
+
+int main()
+{
+    TestSolveUniquely();
+    TestSolveByGuessing();
+    TestEnsureSolution();
+    TestArenaOverflow();
+    printf("SolverTests: %d failed\n", Failures);
+    return Failures;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "SudokuState.h"
+
+// Each test program returns the number of checks that failed
+static int Failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if( !(condition) ) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            Failures++; \
+        } \
+    } while( false )
+
+// The classic example, which has a unique solution
+static const char* const TestPuzzle = "53..7....6..195....98....6.8...6...34..8.3..17...2...6.6....28....419..5....8..79";
+
+// Digits are givens, '.' is empty
+static inline void SetPuzzle( SudokuState& state, const char* puzzle )
+{
+    state.GenerateEmpty();
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        if( puzzle[cell] != '.' )
+            state.GetSquare(cell%9,cell/9).SetSolution(puzzle[cell] - '0');
+    state.MarkFixedAsGiven();
+}
@@ -0,0 +1,138 @@
+#include "SudokuBoard.h"
+#include "SudokuVariants.h"
+
+#include "TestCheck.h"
+
+// Unique for their own rules, found with GenerateRandom
+static const char* DiagonalPuzzle = "....45.......7...33....9..........94.594...6.8.....2719....1..6....86.42672..4.1.";
+static const char* WindokuPuzzle  = "4..5..2....317..6.5.7....89..5....7...28..9419......257..32....1........8...9...2";
+static const char* KillerSolution = "456172398872693514931548672649821753713459826528736149384217965165984237297365481";
+
+template <class Board>
+static void SetPuzzle( Board& board, const char* text )
+{
+    board.GenerateEmpty();
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        if( text[cell] != '.' )
+            board.GetSquare(cell%9, cell/9).SetSolution(text[cell] - '0');
+    board.MarkFixedAsGiven();
+}
+
+// The givens are kept and every row, column and block holds each value once
+template <class Board>
+static bool SolvedFrom( Board& board, const char* text )
+{
+    if( !board.Solved() )
+        return false;
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        if( text[cell] != '.' && board.GetSquare(cell%9, cell/9).FirstPossible() != text[cell] - '0' )
+            return false;
+    for( uint8_t i = 0 ; i < 9 ; i++ )
+    {
+        uint16_t row = 0, column = 0, block = 0;
+        for( uint8_t j = 0 ; j < 9 ; j++ )
+        {
+            row |= 1 << board.GetSquare(j, i).FirstPossible();
+            column |= 1 << board.GetSquare(i, j).FirstPossible();
+            block |= 1 << board.GetSquare(i%3*3 + j%3, i/3*3 + j/3).FirstPossible();
+        }
+        if( row != 0x3FE || column != 0x3FE || block != 0x3FE )
+            return false;
+    }
+    return true;
+}
+
+static void TestDiagonal()
+{
+    SudokuBoard<3,DiagonalRules<3>> board;
+    SetPuzzle(board, DiagonalPuzzle);
+    CHECK(board.SolveUniquely() == 1);
+    CHECK(board.SolveByGuessing());
+    CHECK(SolvedFrom(board, DiagonalPuzzle));
+    uint16_t down = 0, up = 0;
+    for( uint8_t i = 0 ; i < 9 ; i++ )
+    {
+        down |= 1 << board.GetSquare(i, i).FirstPossible();
+        up |= 1 << board.GetSquare(8-i, i).FirstPossible();
+    }
+    CHECK(down == 0x3FE && up == 0x3FE);
+
+    // The same givens have other solutions without the diagonals
+    SudokuBoard<3> classic;
+    SetPuzzle(classic, DiagonalPuzzle);
+    CHECK(classic.SolveUniquely() == 2);
+}
+
+static void TestWindoku()
+{
+    SudokuBoard<3,WindokuRules<3>> board;
+    SetPuzzle(board, WindokuPuzzle);
+    CHECK(board.SolveUniquely() == 1);
+    CHECK(board.SolveByGuessing());
+    CHECK(SolvedFrom(board, WindokuPuzzle));
+    for( uint8_t window = 0 ; window < 4 ; window++ )
+    {
+        uint16_t seen = 0;
+        for( uint8_t j = 0 ; j < 9 ; j++ )
+            seen |= 1 << board.GetSquare(1 + window%2*4 + j%3, 1 + window/2*4 + j/3).FirstPossible();
+        CHECK(seen == 0x3FE);
+    }
+
+    SudokuBoard<3> classic;
+    SetPuzzle(classic, WindokuPuzzle);
+    CHECK(classic.SolveUniquely() == 2);
+}
+
+// Cages cut from a solved board cover it once, hold distinct values adding to their totals,
+// and with enough givens from that board lead back to it
+static void TestKiller()
+{
+    SudokuBoard<3> solved;
+    SetPuzzle(solved, KillerSolution);
+    SudokuBoard<3,KillerRules<3>> board;
+    auto& cages = board.GetConstraints();
+    cages.GenerateCages(solved, 4);
+
+    uint16_t covered[81] = {};
+    for( uint16_t cage = 0 ; cage < cages.Groups() ; cage++ )
+    {
+        CHECK(cages.GroupSize(cage) >= 1 && cages.GroupSize(cage) <= 4);
+        uint16_t seen = 0, sum = 0;
+        for( uint8_t i = 0 ; i < cages.GroupSize(cage) ; i++ )
+        {
+            uint8_t cell = cages.GroupCells(cage)[i];
+            uint8_t val = KillerSolution[cell] - '0';
+            covered[cell]++;
+            CHECK(!(seen & (1 << val)));
+            seen |= 1 << val;
+            sum += val;
+        }
+        CHECK(sum == cages.CageTotal(cage));
+    }
+    for( uint8_t cell = 0 ; cell < 81 ; cell++ )
+        CHECK(covered[cell] == 1);
+
+    char givens[82];
+    memset(givens, '.', 81);
+    givens[81] = 0;
+    SetPuzzle(board, givens);
+    for( uint8_t i = 0 ; i < 81 && board.SolveUniquely() != 1 ; i++ )
+    {
+        uint8_t cell = i*7 % 81;
+        givens[cell] = KillerSolution[cell];
+        SetPuzzle(board, givens);
+    }
+    CHECK(board.SolveUniquely() == 1);
+    CHECK(board.SolveByGuessing());
+    CHECK(SolvedFrom(board, KillerSolution));
+    CHECK(board.Valid());
+}
+
+int main()
+{
+    TestDiagonal();
+    TestWindoku();
+    TestKiller();
+    printf("VariantTests: %d failed\n", Failures);
+    return Failures;
+}
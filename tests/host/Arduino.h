@@ -0,0 +1,50 @@
+#pragma once
+
+// Just enough of the ESP32 Arduino core to build the game logic on a PC for the tests
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+#define log_d(...)  do {} while( false )
+#define log_i(...)  do {} while( false )
+#define log_w(...)  do {} while( false )
+#define log_e(...)  do {} while( false )
+
+uint32_t    millis();
+uint32_t    micros();
+long        random( long howbig );
+long        random( long howsmall, long howbig );
+
+class String
+{
+protected:
+    std::string Text;
+
+public:
+    String( const char* str = "" ) : Text(str) {};
+    String( int value ) : Text(std::to_string(value)) {};
+    const char* c_str() const { return Text.c_str(); };
+    unsigned    length() const { return Text.size(); };
+    char        operator[]( unsigned i ) const { return Text[i]; };
+    bool        operator==( const char* str ) const { return Text == str; };
+    String      substring( unsigned from, unsigned to ) const { return String(Text.substr(from, to - from).c_str()); };
+    String&     operator+=( const String& str ) { Text += str.Text; return *this; };
+    String&     operator+=( const char* str ) { Text += str; return *this; };
+    String&     operator+=( char c ) { Text += c; return *this; };
+    String      operator+( const String& str ) const { String ret(*this); ret += str; return ret; };
+    long        toInt() const { return atol(Text.c_str()); };
+};
+
+struct EspClass
+{
+    uint32_t    getCycleCount() { return 0; };
+    uint32_t    getFreeHeap() { return 0; };
+};
+extern EspClass ESP;
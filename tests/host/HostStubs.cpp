@@ -0,0 +1,38 @@
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// What the sketch itself would define
+Preferences preferences;
+const char* Preferences_App = "M5Sudoku";
+std::vector<uint8_t> vector_rand81(81);
+std::mt19937 g_(1);
+
+Preferences::Storage Preferences::Keys;
+bool Preferences::FailWrites = false;
+EspClass ESP;
+
+static const auto Start = std::chrono::steady_clock::now();
+
+uint32_t millis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - Start).count();
+}
+
+uint32_t micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Start).count();
+}
+
+long random( long howbig )
+{
+    return howbig > 0 ? g_() % howbig : 0;
+}
+
+long random( long howsmall, long howbig )
+{
+    return howsmall < howbig ? howsmall + random(howbig - howsmall) : howsmall;
+}
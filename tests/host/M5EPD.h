@@ -0,0 +1,16 @@
+#pragma once
+
+// Perf.h only needs the update modes
+
+enum m5epd_update_mode_t
+{
+    UPDATE_MODE_INIT = 0,
+    UPDATE_MODE_DU = 1,
+    UPDATE_MODE_GC16 = 2,
+    UPDATE_MODE_GL16 = 3,
+    UPDATE_MODE_GLR16 = 4,
+    UPDATE_MODE_GLD16 = 5,
+    UPDATE_MODE_DU4 = 6,
+    UPDATE_MODE_A2 = 7,
+    UPDATE_MODE_NONE = 8
+};
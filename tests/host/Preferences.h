@@ -0,0 +1,42 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+// NVS as a map, shared by every instance as the real one is, which tests can look at and change
+class Preferences
+{
+public:
+    using Storage = std::map<std::string,std::vector<uint8_t>>;
+    static Storage  Keys;
+    static bool     FailWrites;     // As when NVS is full
+
+    bool        begin( const char*, bool = false ) { return true; };
+    void        end() {};
+    bool        remove( const char* key ) { return Keys.erase(key) > 0; };
+    bool        isKey( const char* key ) { return Keys.count(key) > 0; };
+
+    size_t      putBytes( const char* key, const void* value, size_t length )
+    {
+        if( FailWrites )
+            return 0;
+        Keys[key].assign((const uint8_t*)value, (const uint8_t*)value + length);
+        return length;
+    }
+    size_t      getBytesLength( const char* key ) { auto it = Keys.find(key); return it == Keys.end() ? 0 : it->second.size(); };
+    size_t      getBytes( const char* key, void* buffer, size_t maxLength )
+    {
+        auto it = Keys.find(key);
+        if( it == Keys.end() || it->second.size() > maxLength )
+            return 0;
+        memcpy(buffer, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+    size_t      putULong( const char* key, uint32_t value ) { return putBytes(key, &value, sizeof(value)); };
+    size_t      putBool( const char* key, bool value ) { return putBytes(key, &value, sizeof(value)); };
+    uint32_t    getULong( const char* key, uint32_t defaultValue = 0 ) { uint32_t value; return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue; };
+    bool        getBool( const char* key, bool defaultValue = false ) { bool value; return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue; };
+};
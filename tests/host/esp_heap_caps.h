@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+
+inline void* heap_caps_malloc( size_t size, uint32_t ) { return malloc(size); }
+inline void heap_caps_free( void* p ) { free(p); }